@@ -14,6 +14,10 @@
 #include <linux/version.h>
 
 #include <linux/cpu.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
@@ -26,6 +30,19 @@
 
 #include <jailhouse/hypercall.h>
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,14,0)
+static ssize_t compat_kernel_read(struct file *file, void *buf, size_t count,
+				  loff_t *pos)
+{
+	ssize_t result = kernel_read(file, *pos, buf, count);
+
+	if (result > 0)
+		*pos += result;
+	return result;
+}
+#define kernel_read		compat_kernel_read
+#endif /* < 4.14 */
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,7,0)
 #define add_cpu(cpu)		cpu_up(cpu)
 #define remove_cpu(cpu)		cpu_down(cpu)
@@ -302,99 +319,230 @@ static int cell_management_prologue(struct jailhouse_cell_id *cell_id,
 
 #define MEM_REQ_FLAGS	(JAILHOUSE_MEM_WRITE | JAILHOUSE_MEM_LOADABLE)
 
-static int load_image(struct cell *cell,
-		      struct jailhouse_preload_image __user *uimage)
-{
-	struct jailhouse_preload_image image;
+/* bounds the image array that is allocated on behalf of the caller */
+#define MAX_PRELOAD_IMAGES	64
+
+/* largest unused range that is mapped to load neighboring images at once */
+#define MAX_MERGE_GAP		(2 * 1024 * 1024)
+
+struct load_image {
+	struct jailhouse_preload_image desc;
 	const struct jailhouse_memory *mem;
-	unsigned int regions, page_offs;
-	u64 image_offset, phys_start;
-	void *image_mem;
-	int err = 0;
+	u64 offset;
+	bool loaded;
+};
 
-	if (copy_from_user(&image, uimage, sizeof(image)))
-		return -EFAULT;
+static int prepare_image(struct cell *cell, struct load_image *image)
+{
+	const struct jailhouse_memory *mem = cell->memory_regions;
+	unsigned int regions;
+	u64 image_offset;
+
+	if (image->desc.flags & ~JAILHOUSE_IMAGE_VALID_FLAGS)
+		return -EINVAL;
 
-	if (image.size == 0)
+	if (image->desc.size == 0) {
+		image->loaded = true;
 		return 0;
+	}
 
-	mem = cell->memory_regions;
 	for (regions = cell->num_memory_regions; regions > 0; regions--) {
-		image_offset = image.target_address - mem->virt_start;
-		if (image.target_address >= mem->virt_start &&
+		image_offset = image->desc.target_address - mem->virt_start;
+		if (image->desc.target_address >= mem->virt_start &&
 		    image_offset < mem->size) {
-			if (image.size > mem->size - image_offset ||
+			if (image->desc.size > mem->size - image_offset ||
 			    (mem->flags & MEM_REQ_FLAGS) != MEM_REQ_FLAGS)
 				return -EINVAL;
-			break;
+			image->mem = mem;
+			image->offset = image_offset;
+			return 0;
 		}
 		mem++;
 	}
-	if (regions == 0)
-		return -EINVAL;
+	return -EINVAL;
+}
+
+static int read_image_file(const struct jailhouse_preload_image *desc,
+			   void *dest)
+{
+	loff_t pos = desc->source_address;
+	u64 size = desc->size;
+	struct file *file;
+	ssize_t result;
+	int err = 0;
+
+	file = fget(desc->source_fd);
+	if (!file)
+		return -EBADF;
+
+	while (size > 0) {
+		result = kernel_read(file, dest, min_t(u64, size, MAX_RW_COUNT),
+				     &pos);
+		if (result <= 0) {
+			/* file ends before the image is complete */
+			err = result < 0 ? result : -EINVAL;
+			break;
+		}
+		dest += result;
+		size -= result;
+	}
 
-	phys_start = (mem->phys_start + image_offset) & PAGE_MASK;
-	page_offs = offset_in_page(image_offset);
-	image_mem = jailhouse_ioremap(phys_start, 0,
-				      PAGE_ALIGN(image.size + page_offs));
-	if (!image_mem) {
+	fput(file);
+
+	return err;
+}
+
+/*
+ * Load all pending images that target the memory region of the first one and
+ * lie close to it via a single mapping that spans them. Images further away
+ * are left for a separate mapping so that large gaps are not mapped.
+ */
+static int load_region(struct load_image *images, unsigned int num)
+{
+	const struct jailhouse_memory *mem = images[0].mem;
+	u64 map_start = images[0].offset & PAGE_MASK;
+	u64 map_end = images[0].offset + images[0].desc.size;
+	u64 image_start, image_end;
+	struct load_image *image;
+	void *region_mem, *image_mem;
+	bool merged;
+	unsigned int n;
+	int err = 0;
+
+	do {
+		merged = false;
+		for (n = 1, image = images + 1; n < num; n++, image++) {
+			if (image->loaded || image->mem != mem)
+				continue;
+			image_start = image->offset & PAGE_MASK;
+			image_end = image->offset + image->desc.size;
+			if ((image_start >= map_start && image_end <= map_end) ||
+			    image_start > map_end + MAX_MERGE_GAP ||
+			    image_end + MAX_MERGE_GAP < map_start)
+				continue;
+			map_start = min(map_start, image_start);
+			map_end = max(map_end, image_end);
+			merged = true;
+		}
+	} while (merged);
+
+	region_mem = jailhouse_ioremap(mem->phys_start + map_start, 0,
+				       PAGE_ALIGN(map_end - map_start));
+	if (!region_mem) {
 		pr_err("jailhouse: Unable to map cell RAM at %08llx "
 		       "for image loading\n",
-		       (unsigned long long)(mem->phys_start + image_offset));
+		       (unsigned long long)(mem->phys_start + map_start));
 		return -EBUSY;
 	}
 
-	if (copy_from_user(image_mem + page_offs,
-			   (void __user *)(unsigned long)image.source_address,
-			   image.size))
-		err = -EFAULT;
-	/*
-	 * ARMv7 and ARMv8 require to clean D-cache and invalidate I-cache for
-	 * memory containing new instructions. On x86 this is a NOP.
-	 */
-	flush_icache_range((unsigned long)(image_mem + page_offs),
-			   (unsigned long)(image_mem + page_offs) + image.size);
+	for (n = 0, image = images; n < num; n++, image++) {
+		if (image->loaded || image->mem != mem ||
+		    image->offset < map_start ||
+		    image->offset + image->desc.size > map_end)
+			continue;
+
+		image_mem = region_mem + (image->offset - map_start);
+
+		if (image->desc.flags & JAILHOUSE_IMAGE_SOURCE_FD)
+			err = read_image_file(&image->desc, image_mem);
+		else if (copy_from_user(image_mem,
+					(void __user *)(unsigned long)
+					image->desc.source_address,
+					image->desc.size))
+			err = -EFAULT;
+		/*
+		 * ARMv7 and ARMv8 require to clean D-cache and invalidate
+		 * I-cache for memory containing new instructions. On x86 this
+		 * is a NOP.
+		 */
+		flush_icache_range((unsigned long)image_mem,
+				   (unsigned long)image_mem + image->desc.size);
 #ifdef CONFIG_ARM
-	/*
-	 * ARMv7 requires to flush the written code and data out of D-cache to
-	 * allow the guest starting off with caches disabled.
-	 */
-	__cpuc_flush_dcache_area(image_mem + page_offs, image.size);
+		/*
+		 * ARMv7 requires to flush the written code and data out of
+		 * D-cache to allow the guest starting off with caches
+		 * disabled.
+		 */
+		__cpuc_flush_dcache_area(image_mem, image->desc.size);
 #endif
+		image->loaded = true;
+		if (err)
+			break;
+	}
 
-	vunmap(image_mem);
+	vunmap(region_mem);
 
 	return err;
 }
 
 int jailhouse_cmd_cell_load(struct jailhouse_cell_load __user *arg)
 {
-	struct jailhouse_preload_image __user *image = arg->image;
 	struct jailhouse_cell_load cell_load;
+	struct load_image *images = NULL;
+	u64 total_size = 0, usecs;
 	struct cell *cell;
 	unsigned int n;
+	ktime_t start;
 	int err;
 
 	if (copy_from_user(&cell_load, arg, sizeof(cell_load)))
 		return -EFAULT;
 
+	if (cell_load.num_preload_images > MAX_PRELOAD_IMAGES)
+		return -E2BIG;
+
+	if (cell_load.num_preload_images > 0) {
+		images = kcalloc(cell_load.num_preload_images, sizeof(*images),
+				 GFP_KERNEL);
+		if (!images)
+			return -ENOMEM;
+	}
+
+	for (n = 0; n < cell_load.num_preload_images; n++)
+		if (copy_from_user(&images[n].desc, &arg->image[n],
+				   sizeof(images[n].desc))) {
+			err = -EFAULT;
+			goto kfree_out;
+		}
+
 	err = cell_management_prologue(&cell_load.cell_id, &cell);
 	if (err)
-		return err;
+		goto kfree_out;
 
 	err = jailhouse_call_arg1(JAILHOUSE_HC_CELL_SET_LOADABLE, cell->id);
 	if (err)
 		goto unlock_out;
 
-	for (n = cell_load.num_preload_images; n > 0; n--, image++) {
-		err = load_image(cell, image);
+	for (n = 0; n < cell_load.num_preload_images; n++) {
+		err = prepare_image(cell, &images[n]);
 		if (err)
-			break;
+			goto unlock_out;
+		total_size += images[n].desc.size;
+	}
+
+	start = ktime_get();
+
+	for (n = 0; n < cell_load.num_preload_images; n++) {
+		if (images[n].loaded)
+			continue;
+		err = load_region(&images[n], cell_load.num_preload_images - n);
+		if (err)
+			goto unlock_out;
+	}
+
+	if (total_size > 0) {
+		usecs = ktime_us_delta(ktime_get(), start);
+		pr_info("Loaded %llu KiB into Jailhouse cell \"%s\" in %llu us "
+			"(%llu us/MiB)\n", total_size >> 10, cell->name, usecs,
+			div64_u64(usecs << 20, total_size));
 	}
 
 unlock_out:
 	mutex_unlock(&jailhouse_lock);
 
+kfree_out:
+	kfree(images);
+
 	return err;
 }
 
@@ -50,11 +50,16 @@ struct jailhouse_cell_create {
 	__u32 padding;
 };
 
+#define JAILHOUSE_IMAGE_SOURCE_FD	0x0001
+#define JAILHOUSE_IMAGE_VALID_FLAGS	JAILHOUSE_IMAGE_SOURCE_FD
+
 struct jailhouse_preload_image {
+	/* with JAILHOUSE_IMAGE_SOURCE_FD: offset in the file source_fd */
 	__u64 source_address;
 	__u64 size;
 	__u64 target_address;
-	__u64 padding;
+	__u32 flags;
+	__s32 source_fd;
 };
 
 struct jailhouse_cell_id {
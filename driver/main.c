@@ -882,6 +882,58 @@ console_free_out:
 	return ret;
 }
 
+/*
+ * Maps the hypervisor trace rings read-only. The file offset selects the
+ * position inside the ring area, i.e. CPU n starts at n times the ring size.
+ */
+static int jailhouse_trace_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+	struct jailhouse_header *header;
+	unsigned long area_size;
+	int offset, ring_size;
+	int err;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	if (mutex_lock_interruptible(&jailhouse_lock) != 0)
+		return -EINTR;
+
+	err = -EINVAL;
+	if (!jailhouse_enabled)
+		goto unlock_out;
+
+	offset = jailhouse_call_arg1(JAILHOUSE_HC_HYPERVISOR_GET_INFO,
+				     JAILHOUSE_INFO_TRACE_OFFSET);
+	ring_size = jailhouse_call_arg1(JAILHOUSE_HC_HYPERVISOR_GET_INFO,
+					JAILHOUSE_INFO_TRACE_SIZE);
+	if (offset < 0 || ring_size < 0) {
+		err = -ENODEV;
+		goto unlock_out;
+	}
+
+	header = (struct jailhouse_header *)hypervisor_mem;
+	area_size = (unsigned long)header->max_cpus * ring_size;
+	if (vma->vm_pgoff > area_size >> PAGE_SHIFT ||
+	    size > area_size - (vma->vm_pgoff << PAGE_SHIFT))
+		goto unlock_out;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+	err = remap_pfn_range(vma, vma->vm_start,
+			      ((hypervisor_mem_res->start + offset) >>
+			       PAGE_SHIFT) + vma->vm_pgoff,
+			      size, vma->vm_page_prot);
+
+unlock_out:
+	mutex_unlock(&jailhouse_lock);
+
+	return err;
+}
 
 static const struct file_operations jailhouse_fops = {
 	.owner = THIS_MODULE,
@@ -891,6 +943,7 @@ static const struct file_operations jailhouse_fops = {
 	.open = jailhouse_console_open,
 	.release = jailhouse_console_release,
 	.read = jailhouse_console_read,
+	.mmap = jailhouse_trace_mmap,
 };
 
 static struct miscdevice jailhouse_misc_dev = {
@@ -73,6 +73,7 @@ static struct kobject *cells_dir;
 
 struct cell_cpu {
 	struct kobject kobj;
+	struct kobject latency_kobj;
 	struct list_head entry;
 	unsigned int cpu;
 };
@@ -122,6 +123,37 @@ static ssize_t cpu_stats_show(struct kobject *kobj,
 	return sprintf(buffer, "%d\n", value);
 }
 
+static ssize_t cpu_latency_show(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				char *buffer)
+{
+	struct jailhouse_cpu_stats_attr *stats_attr =
+		container_of(attr, struct jailhouse_cpu_stats_attr, kattr);
+	unsigned int code = JAILHOUSE_CPU_INFO_LATENCY_BASE +
+		stats_attr->code * JAILHOUSE_CPU_LATENCY_BUCKETS;
+	struct cell_cpu *cell_cpu =
+		container_of(kobj, struct cell_cpu, latency_kobj);
+	unsigned int bucket;
+	ssize_t written = 0;
+	int value;
+
+	for (bucket = 0; bucket < JAILHOUSE_CPU_LATENCY_BUCKETS; bucket++) {
+		value = jailhouse_call_arg2(JAILHOUSE_HC_CPU_GET_INFO,
+					    cell_cpu->cpu, code + bucket);
+		/* histograms are not compiled into the hypervisor */
+		if (value < 0)
+			return value;
+		if (value == 0)
+			continue;
+
+		written += scnprintf(buffer + written, PAGE_SIZE - written,
+				     "%lu %d\n", bucket ? 1UL << bucket : 0,
+				     value);
+	}
+
+	return written;
+}
+
 #define JAILHOUSE_CPU_STATS_ATTR(_name, _code) \
 	static struct jailhouse_cpu_stats_attr _name##_cell_attr = { \
 		.kattr = __ATTR(_name, S_IRUGO, cell_stats_show, NULL), \
@@ -132,33 +164,45 @@ static ssize_t cpu_stats_show(struct kobject *kobj,
 		.code = _code, \
 	}
 
-JAILHOUSE_CPU_STATS_ATTR(vmexits_total, JAILHOUSE_CPU_STAT_VMEXITS_TOTAL);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_mmio, JAILHOUSE_CPU_STAT_VMEXITS_MMIO);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_management,
-			 JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_hypercall,
-			 JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL);
+#define JAILHOUSE_CPU_VMEXITS_ATTR(_name, _code) \
+	JAILHOUSE_CPU_STATS_ATTR(_name, _code); \
+	static struct jailhouse_cpu_stats_attr _name##_latency_attr = { \
+		.kattr = __ATTR(_name, S_IRUGO, cpu_latency_show, NULL), \
+		.code = _code, \
+	}
+
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_total, JAILHOUSE_CPU_STAT_VMEXITS_TOTAL);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_mmio, JAILHOUSE_CPU_STAT_VMEXITS_MMIO);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_management,
+			   JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_hypercall,
+			   JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL);
+JAILHOUSE_CPU_STATS_ATTR(mmio_cache_hits, JAILHOUSE_CPU_STAT_MMIO_CACHE_HITS);
 #ifdef CONFIG_X86
-JAILHOUSE_CPU_STATS_ATTR(vmexits_pio, JAILHOUSE_CPU_STAT_VMEXITS_PIO);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_xapic, JAILHOUSE_CPU_STAT_VMEXITS_XAPIC);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_cr, JAILHOUSE_CPU_STAT_VMEXITS_CR);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_cpuid, JAILHOUSE_CPU_STAT_VMEXITS_CPUID);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_xsetbv, JAILHOUSE_CPU_STAT_VMEXITS_XSETBV);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_exception,
-			 JAILHOUSE_CPU_STAT_VMEXITS_EXCEPTION);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_msr_other,
-			 JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_msr_x2apic_icr,
-			 JAILHOUSE_CPU_STAT_VMEXITS_MSR_X2APIC_ICR);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_pio, JAILHOUSE_CPU_STAT_VMEXITS_PIO);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_xapic, JAILHOUSE_CPU_STAT_VMEXITS_XAPIC);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_cr, JAILHOUSE_CPU_STAT_VMEXITS_CR);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_cpuid, JAILHOUSE_CPU_STAT_VMEXITS_CPUID);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_xsetbv, JAILHOUSE_CPU_STAT_VMEXITS_XSETBV);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_exception,
+			   JAILHOUSE_CPU_STAT_VMEXITS_EXCEPTION);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_msr_other,
+			   JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_msr_x2apic_icr,
+			   JAILHOUSE_CPU_STAT_VMEXITS_MSR_X2APIC_ICR);
+JAILHOUSE_CPU_STATS_ATTR(iommu_inv_page, JAILHOUSE_CPU_STAT_IOMMU_INV_PAGE);
+JAILHOUSE_CPU_STATS_ATTR(iommu_inv_domain,
+			 JAILHOUSE_CPU_STAT_IOMMU_INV_DOMAIN);
 #elif defined(CONFIG_ARM) || defined(CONFIG_ARM64)
-JAILHOUSE_CPU_STATS_ATTR(vmexits_maintenance,
-			 JAILHOUSE_CPU_STAT_VMEXITS_MAINTENANCE);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_virt_irq, JAILHOUSE_CPU_STAT_VMEXITS_VIRQ);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_virt_sgi, JAILHOUSE_CPU_STAT_VMEXITS_VSGI);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_psci, JAILHOUSE_CPU_STAT_VMEXITS_PSCI);
-JAILHOUSE_CPU_STATS_ATTR(vmexits_smccc, JAILHOUSE_CPU_STAT_VMEXITS_SMCCC);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_maintenance,
+			   JAILHOUSE_CPU_STAT_VMEXITS_MAINTENANCE);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_virt_irq, JAILHOUSE_CPU_STAT_VMEXITS_VIRQ);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_virt_sgi, JAILHOUSE_CPU_STAT_VMEXITS_VSGI);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_psci, JAILHOUSE_CPU_STAT_VMEXITS_PSCI);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_smccc, JAILHOUSE_CPU_STAT_VMEXITS_SMCCC);
+JAILHOUSE_CPU_STATS_ATTR(virq_overflows, JAILHOUSE_CPU_STAT_VIRQ_OVERFLOWS);
 #ifdef CONFIG_ARM
-JAILHOUSE_CPU_STATS_ATTR(vmexits_cp15, JAILHOUSE_CPU_STAT_VMEXITS_CP15);
+JAILHOUSE_CPU_VMEXITS_ATTR(vmexits_cp15, JAILHOUSE_CPU_STAT_VMEXITS_CP15);
 #endif
 #endif
 
@@ -167,6 +211,7 @@ static struct attribute *cell_stats_attrs[] = {
 	&vmexits_mmio_cell_attr.kattr.attr,
 	&vmexits_management_cell_attr.kattr.attr,
 	&vmexits_hypercall_cell_attr.kattr.attr,
+	&mmio_cache_hits_cell_attr.kattr.attr,
 #ifdef CONFIG_X86
 	&vmexits_pio_cell_attr.kattr.attr,
 	&vmexits_xapic_cell_attr.kattr.attr,
@@ -176,12 +221,15 @@ static struct attribute *cell_stats_attrs[] = {
 	&vmexits_exception_cell_attr.kattr.attr,
 	&vmexits_msr_other_cell_attr.kattr.attr,
 	&vmexits_msr_x2apic_icr_cell_attr.kattr.attr,
+	&iommu_inv_page_cell_attr.kattr.attr,
+	&iommu_inv_domain_cell_attr.kattr.attr,
 #elif defined(CONFIG_ARM) || defined(CONFIG_ARM64)
 	&vmexits_maintenance_cell_attr.kattr.attr,
 	&vmexits_virt_irq_cell_attr.kattr.attr,
 	&vmexits_virt_sgi_cell_attr.kattr.attr,
 	&vmexits_psci_cell_attr.kattr.attr,
 	&vmexits_smccc_cell_attr.kattr.attr,
+	&virq_overflows_cell_attr.kattr.attr,
 #ifdef CONFIG_ARM
 	&vmexits_cp15_cell_attr.kattr.attr,
 #endif
@@ -200,6 +248,7 @@ static struct attribute *cpu_stats_attrs[] = {
 	&vmexits_mmio_cpu_attr.kattr.attr,
 	&vmexits_management_cpu_attr.kattr.attr,
 	&vmexits_hypercall_cpu_attr.kattr.attr,
+	&mmio_cache_hits_cpu_attr.kattr.attr,
 #ifdef CONFIG_X86
 	&vmexits_pio_cpu_attr.kattr.attr,
 	&vmexits_xapic_cpu_attr.kattr.attr,
@@ -209,12 +258,15 @@ static struct attribute *cpu_stats_attrs[] = {
 	&vmexits_exception_cpu_attr.kattr.attr,
 	&vmexits_msr_other_cpu_attr.kattr.attr,
 	&vmexits_msr_x2apic_icr_cpu_attr.kattr.attr,
+	&iommu_inv_page_cpu_attr.kattr.attr,
+	&iommu_inv_domain_cpu_attr.kattr.attr,
 #elif defined(CONFIG_ARM) || defined(CONFIG_ARM64)
 	&vmexits_maintenance_cpu_attr.kattr.attr,
 	&vmexits_virt_irq_cpu_attr.kattr.attr,
 	&vmexits_virt_sgi_cpu_attr.kattr.attr,
 	&vmexits_psci_cpu_attr.kattr.attr,
 	&vmexits_smccc_cpu_attr.kattr.attr,
+	&virq_overflows_cpu_attr.kattr.attr,
 #ifdef CONFIG_ARM
 	&vmexits_cp15_cpu_attr.kattr.attr,
 #endif
@@ -228,6 +280,39 @@ static struct kobj_type cell_cpu_type = {
 	DEFAULT_GROUPS(cpu_stats),
 };
 
+static struct attribute *cpu_latency_attrs[] = {
+	&vmexits_total_latency_attr.kattr.attr,
+	&vmexits_mmio_latency_attr.kattr.attr,
+	&vmexits_management_latency_attr.kattr.attr,
+	&vmexits_hypercall_latency_attr.kattr.attr,
+#ifdef CONFIG_X86
+	&vmexits_pio_latency_attr.kattr.attr,
+	&vmexits_xapic_latency_attr.kattr.attr,
+	&vmexits_cr_latency_attr.kattr.attr,
+	&vmexits_cpuid_latency_attr.kattr.attr,
+	&vmexits_xsetbv_latency_attr.kattr.attr,
+	&vmexits_exception_latency_attr.kattr.attr,
+	&vmexits_msr_other_latency_attr.kattr.attr,
+	&vmexits_msr_x2apic_icr_latency_attr.kattr.attr,
+#elif defined(CONFIG_ARM) || defined(CONFIG_ARM64)
+	&vmexits_maintenance_latency_attr.kattr.attr,
+	&vmexits_virt_irq_latency_attr.kattr.attr,
+	&vmexits_virt_sgi_latency_attr.kattr.attr,
+	&vmexits_psci_latency_attr.kattr.attr,
+	&vmexits_smccc_latency_attr.kattr.attr,
+#ifdef CONFIG_ARM
+	&vmexits_cp15_latency_attr.kattr.attr,
+#endif
+#endif
+	NULL
+};
+COMPAT_ATTRIBUTE_GROUPS(cpu_latency);
+
+static struct kobj_type cpu_latency_type = {
+	.sysfs_ops = &kobj_sysfs_ops,
+	DEFAULT_GROUPS(cpu_latency),
+};
+
 static int print_cpumask(char *buf, size_t size, cpumask_t *mask, bool as_list)
 {
 	int written;
@@ -414,6 +499,18 @@ int jailhouse_sysfs_cell_create(struct cell *cell)
 				jailhouse_sysfs_cell_delete(cell);
 				return err;
 			}
+
+			err = kobject_init_and_add(&cell_cpu->latency_kobj,
+						   &cpu_latency_type,
+						   &cell_cpu->kobj, "%s",
+						   "latency");
+			if (err) {
+				kobject_put(&cell_cpu->latency_kobj);
+				kobject_put(&cell_cpu->kobj);
+				kfree(cell_cpu);
+				jailhouse_sysfs_cell_delete(cell);
+				return err;
+			}
 			list_add_tail(&cell_cpu->entry, &cell->cell_cpus);
 		} else {
 			cell_cpu = find_cell_cpu(root_cell, cpu);
@@ -446,6 +543,7 @@ void jailhouse_sysfs_cell_delete(struct cell *cell)
 		list_for_each_entry_safe(cell_cpu, tmp, &cell->cell_cpus,
 					 entry) {
 			list_del(&cell_cpu->entry);
+			kobject_put(&cell_cpu->latency_kobj);
 			kobject_put(&cell_cpu->kobj);
 			kfree(cell_cpu);
 		}
@@ -13,6 +13,7 @@
  */
 
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/printk.h>
 #include <asm/control.h>
 #include <asm/iommu.h>
@@ -120,11 +121,13 @@ void arch_handle_sgi(u32 irqn, unsigned int count_event)
 	case SGI_INJECT:
 		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_VSGI] +=
 			count_event;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_VSGI);
 		irqchip_inject_pending();
 		break;
 	case SGI_EVENT:
 		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT] +=
 			count_event;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT);
 		check_events(cpu_public);
 		break;
 	default:
@@ -143,12 +146,14 @@ bool arch_handle_phys_irq(u32 irqn, unsigned int count_event)
 	if (irqn == system_config->platform_info.arm.maintenance_irq) {
 		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_MAINTENANCE] +=
 			count_event;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MAINTENANCE);
 		irqchip_inject_pending();
 
 		return true;
 	}
 
 	cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_VIRQ] += count_event;
+	latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_VIRQ);
 	irqchip_set_pending(cpu_public, irqn);
 
 	return false;
@@ -288,6 +288,7 @@ static void gicv2_send_sgi(struct sgi *sgi)
 
 static int gicv2_inject_irq(u16 irq_id, u16 sender)
 {
+	u16 *lr_irq = this_cpu_data()->lr_irq;
 	unsigned int n;
 	int first_free = -1;
 	u32 lr;
@@ -303,9 +304,11 @@ static int gicv2_inject_irq(u16 irq_id, u16 sender)
 			continue;
 		}
 
-		/* Check that there is no overlapping */
-		lr = gicv2_read_lr(n);
-		if ((lr & GICH_LR_VIRT_ID_MASK) == irq_id)
+		/*
+		 * Check that there is no overlapping, using the shadowed ID
+		 * instead of reading back the list register.
+		 */
+		if (lr_irq[n] == irq_id)
 			return -EEXIST;
 	}
 
@@ -324,6 +327,7 @@ static int gicv2_inject_irq(u16 irq_id, u16 sender)
 	}
 
 	gicv2_write_lr(first_free, lr);
+	lr_irq[first_free] = irq_id;
 
 	return 0;
 }
@@ -540,38 +540,30 @@ static void gicv3_eoi_irq(u32 irq_id, bool deactivate)
 
 static int gicv3_inject_irq(u16 irq_id, u16 sender)
 {
-	unsigned int n;
-	int free_lr = -1;
+	u16 *lr_irq = this_cpu_data()->lr_irq;
+	unsigned int n, free_lr;
 	u32 elsr;
 	u64 lr;
 
 	arm_read_sysreg(ICH_ELSR_EL2, elsr);
-	for (n = 0; n < gic_num_lr; n++) {
-		if ((elsr >> n) & 1) {
-			/* Entry is invalid, candidate for injection */
-			if (free_lr == -1)
-				free_lr = n;
-			continue;
-		}
-
-		/*
-		 * Entry is in use, check that it doesn't match the one we want
-		 * to inject.
-		 */
-		lr = gicv3_read_lr(n);
+	elsr &= BIT_MASK(gic_num_lr - 1, 0);
 
-		/*
-		 * A strict phys->virt id mapping is used for SPIs, so this test
-		 * should be sufficient.
-		 */
-		if ((u32)lr == irq_id)
+	/*
+	 * Check that none of the entries in use matches the one we want to
+	 * inject. The shadowed IDs avoid reading back the list registers.
+	 * A strict phys->virt id mapping is used for SPIs, so this test
+	 * should be sufficient.
+	 */
+	for (n = 0; n < gic_num_lr; n++)
+		if (!(elsr & (1 << n)) && lr_irq[n] == irq_id)
 			return -EEXIST;
-	}
 
-	if (free_lr == -1)
+	if (!elsr)
 		/* All list registers are in use */
 		return -EBUSY;
 
+	free_lr = ffsl(elsr);
+
 	lr = irq_id;
 	/* Only group 1 interrupts */
 	lr |= ICH_LR_GROUP_BIT;
@@ -583,6 +575,7 @@ static int gicv3_inject_irq(u16 irq_id, u16 sender)
 	/* GICv3 doesn't support the injection of the calling CPU ID */
 
 	gicv3_write_lr(free_lr, lr);
+	lr_irq[free_lr] = irq_id;
 
 	return 0;
 }
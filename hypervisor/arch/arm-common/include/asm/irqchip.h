@@ -13,7 +13,14 @@
 #ifndef _JAILHOUSE_ASM_IRQCHIP_H
 #define _JAILHOUSE_ASM_IRQCHIP_H
 
+/* must be a power of two, ring indexes are free-running */
 #define MAX_PENDING_IRQS	256
+/* overflow bitmap coverage, matches the GIC's INTID limit for SPIs */
+#define MAX_OVERFLOW_IRQS	1024
+/* GICv2 encodes up to 8 SGI senders in the list registers */
+#define MAX_OVERFLOW_SGI_SENDERS	8
+/* GICv2 supports up to 64 list registers, GICv3 up to 16 */
+#define MAX_LIST_REGS		64
 
 #include <jailhouse/cell.h>
 #include <jailhouse/mmio.h>
@@ -67,15 +74,23 @@ struct irqchip {
 	unsigned long gicd_size;
 };
 
+/*
+ * Lock-free multi-producer, single-consumer queue of interrupts to be
+ * injected into the owning CPU. Producers reserve a slot by advancing tail
+ * and then publish the entry. Only the owning CPU consumes entries and
+ * advances head. IRQs that do not fit into the ring are coalesced in the
+ * overflow bitmaps, SGIs per sender.
+ */
 struct pending_irqs {
-	/* synchronizes parallel insertions of SGIs into the pending ring */
-	spinlock_t lock;
-	u16 irqs[MAX_PENDING_IRQS];
-	/* contains the calling CPU ID in case of a SGI */
-	u16 sender[MAX_PENDING_IRQS];
-	unsigned int head;
-	/* removal from the ring happens lockless, thus tail is volatile */
+	/* IRQ ID in bits 0..15, sender CPU ID + 1 in bits 16..31, 0 if free */
+	volatile u32 entries[MAX_PENDING_IRQS];
+	volatile unsigned int head;
 	volatile unsigned int tail;
+	/* true if the overflow bitmaps may contain entries */
+	volatile bool overflowed;
+	unsigned long overflow_irqs[MAX_OVERFLOW_IRQS / BITS_PER_LONG];
+	unsigned long overflow_sgis[16 * MAX_OVERFLOW_SGI_SENDERS /
+				    BITS_PER_LONG];
 };
 
 int irqchip_cpu_init(struct per_cpu *cpu_data);
@@ -17,7 +17,11 @@
 
 #define ARM_PERCPU_FIELDS						\
 	int smccc_feat_workaround_1;					\
-	int smccc_feat_workaround_2;
+	int smccc_feat_workaround_2;					\
+									\
+	/** Virtual IRQ IDs last injected via the list registers. Only	\
+	 *  valid for entries that are not reported empty by ELRSR. */	\
+	u16 lr_irq[MAX_LIST_REGS];
 
 #define ARCH_PUBLIC_PERCPU_FIELDS					\
 	unsigned long mpidr;						\
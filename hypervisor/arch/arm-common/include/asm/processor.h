@@ -31,4 +31,13 @@ static inline void memory_load_barrier(void)
 	dmb(ish);
 }
 
+static inline u64 arch_read_timestamp(void)
+{
+	u64 cnt;
+
+	isb();
+	arm_read_sysreg(CNTPCT_EL0, cnt);
+	return cnt;
+}
+
 #endif /* !__ASSEMBLY__ */
@@ -12,18 +12,24 @@
  * the COPYING file in the top-level directory.
  */
 
+#include <jailhouse/bitops.h>
 #include <jailhouse/control.h>
 #include <jailhouse/entry.h>
 #include <jailhouse/mmio.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/string.h>
+#include <jailhouse/trace.h>
 #include <jailhouse/unit.h>
 #include <asm/control.h>
 #include <asm/gic.h>
 #include <asm/irqchip.h>
 #include <asm/smccc.h>
 
+#define PENDING_ENTRY(irq_id, sender)	((irq_id) | (((sender) + 1) << 16))
+#define PENDING_ENTRY_IRQ(entry)	((entry) & 0xffff)
+#define PENDING_ENTRY_SENDER(entry)	(((entry) >> 16) - 1)
+
 #define for_each_irqchip(chip, config, counter)				\
 	for ((chip) = jailhouse_cell_irqchips(config), (counter) = 0;	\
 	     (counter) < (config)->num_irqchips;			\
@@ -221,12 +227,56 @@ bool irqchip_has_pending_irqs(void)
 	return irqchip.has_pending_irqs();
 }
 
+static bool pending_enqueue(struct pending_irqs *pending, u16 irq_id,
+			    u16 sender)
+{
+	unsigned int head, tail;
+
+	do {
+		/*
+		 * Read head before tail so that a concurrent consumption can
+		 * only make us see less free space, never more.
+		 */
+		head = pending->head;
+		memory_load_barrier();
+		tail = pending->tail;
+		if (tail - head >= MAX_PENDING_IRQS)
+			return false;
+	} while (atomic_cmpxchg(&pending->tail, tail, tail + 1) != tail);
+
+	pending->entries[tail % MAX_PENDING_IRQS] =
+		PENDING_ENTRY(irq_id, sender);
+
+	return true;
+}
+
+static void pending_overflow(struct pending_irqs *pending, u16 irq_id,
+			     u16 sender)
+{
+	/* Queue and bitmaps are per target, thus account it on the sender. */
+	this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VIRQ_OVERFLOWS]++;
+
+	if (is_sgi(irq_id))
+		atomic_test_and_set_bit(irq_id * MAX_OVERFLOW_SGI_SENDERS +
+					sender % MAX_OVERFLOW_SGI_SENDERS,
+					pending->overflow_sgis);
+	else if (irq_id < MAX_OVERFLOW_IRQS)
+		atomic_test_and_set_bit(irq_id, pending->overflow_irqs);
+	else
+		return;
+
+	/* Make the bitmap update visible before flagging it. */
+	memory_barrier();
+	pending->overflowed = true;
+}
+
 void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
 {
 	struct pending_irqs *pending = &cpu_public->pending_irqs;
 	bool local_injection = (this_cpu_public() == cpu_public);
 	const u16 sender = this_cpu_id();
-	unsigned int new_tail;
+
+	trace_point(JAILHOUSE_TRACE_IRQ, cpu_public->cpu_id, irq_id, sender);
 
 	if (sdei_available) {
 		irqchip_send_sgi(cpu_public->cpu_id, irq_id);
@@ -236,27 +286,14 @@ void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
 	if (local_injection && irqchip.inject_irq(irq_id, sender) != -EBUSY)
 		return;
 
-	spin_lock(&pending->lock);
-
-	new_tail = (pending->tail + 1) % MAX_PENDING_IRQS;
-
-	/* Queue space available? */
-	if (new_tail != pending->head) {
-		pending->irqs[pending->tail] = irq_id;
-		pending->sender[pending->tail] = sender;
-		/*
-		 * Make the entry content is visible before updating the tail
-		 * index.
-		 */
-		memory_barrier();
-		pending->tail = new_tail;
-	}
+	if (!pending_enqueue(pending, irq_id, sender))
+		pending_overflow(pending, irq_id, sender);
 
 	/*
-	 * The unlock has memory barrier semantic on ARM v7 and v8. Therefore
-	 * the change to tail will be visible when sending SGI_INJECT later on.
+	 * Make the entry visible before the target CPU is kicked via
+	 * SGI_INJECT.
 	 */
-	spin_unlock(&pending->lock);
+	memory_barrier();
 
 	/*
 	 * The list registers are full, trigger maintenance interrupt if we are
@@ -269,16 +306,80 @@ void irqchip_set_pending(struct public_per_cpu *cpu_public, u16 irq_id)
 		irqchip_send_sgi(cpu_public->cpu_id, SGI_INJECT);
 }
 
+/*
+ * Returns false if the list registers are full and unprocessed bits were
+ * left in the bitmap.
+ */
+static bool inject_overflow_bitmap(unsigned long *bitmap, unsigned int bits,
+				   bool sgis)
+{
+	unsigned int n, pos, irq_id, sender;
+	unsigned long word;
+
+	for (n = 0; n < bits / BITS_PER_LONG; n++) {
+		word = bitmap[n];
+		while (word) {
+			pos = n * BITS_PER_LONG + ffsl(word);
+			word &= word - 1;
+
+			if (!atomic_test_and_clear_bit(pos, bitmap))
+				continue;
+
+			if (sgis) {
+				irq_id = pos / MAX_OVERFLOW_SGI_SENDERS;
+				sender = pos % MAX_OVERFLOW_SGI_SENDERS;
+			} else {
+				irq_id = pos;
+				sender = this_cpu_id();
+			}
+
+			if (irqchip.inject_irq(irq_id, sender) == -EBUSY) {
+				atomic_test_and_set_bit(pos, bitmap);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool inject_overflowed(struct pending_irqs *pending)
+{
+	if (!pending->overflowed)
+		return true;
+
+	/* Clear the flag first so that concurrent overflows re-raise it. */
+	pending->overflowed = false;
+	memory_barrier();
+
+	if (!inject_overflow_bitmap(pending->overflow_sgis,
+				    16 * MAX_OVERFLOW_SGI_SENDERS, true) ||
+	    !inject_overflow_bitmap(pending->overflow_irqs,
+				    MAX_OVERFLOW_IRQS, false)) {
+		pending->overflowed = true;
+		return false;
+	}
+	return true;
+}
+
 void irqchip_inject_pending(void)
 {
 	struct pending_irqs *pending = &this_cpu_public()->pending_irqs;
-	u16 irq_id, sender;
+	unsigned int slot;
+	u32 entry;
 
 	while (pending->head != pending->tail) {
-		irq_id = pending->irqs[pending->head];
-		sender = pending->sender[pending->head];
+		slot = pending->head % MAX_PENDING_IRQS;
+		entry = pending->entries[slot];
 
-		if (irqchip.inject_irq(irq_id, sender) == -EBUSY) {
+		/*
+		 * The slot is reserved but not yet published. Its producer
+		 * will kick us again via SGI_INJECT.
+		 */
+		if (!entry)
+			break;
+
+		if (irqchip.inject_irq(PENDING_ENTRY_IRQ(entry),
+				       PENDING_ENTRY_SENDER(entry)) == -EBUSY) {
 			/*
 			 * The list registers are full, trigger maintenance
 			 * interrupt and leave.
@@ -288,11 +389,17 @@ void irqchip_inject_pending(void)
 		}
 
 		/*
-		 * Ensure that the entry was read before updating the head
-		 * index.
+		 * Ensure that the slot is released before updating the head
+		 * index and handing it over to the producers.
 		 */
+		pending->entries[slot] = 0;
 		memory_barrier();
-		pending->head = (pending->head + 1) % MAX_PENDING_IRQS;
+		pending->head++;
+	}
+
+	if (!inject_overflowed(pending)) {
+		irqchip.enable_maint_irq(true);
+		return;
 	}
 
 	/*
@@ -365,8 +472,8 @@ u64 irqchip_get_cluster_target(unsigned int cpu_id)
 
 void irqchip_cpu_reset(struct per_cpu *cpu_data)
 {
-	cpu_data->public.pending_irqs.head = 0;
-	cpu_data->public.pending_irqs.tail = 0;
+	memset(&cpu_data->public.pending_irqs, 0,
+	       sizeof(cpu_data->public.pending_irqs));
 
 	irqchip.cpu_reset(cpu_data);
 }
@@ -374,7 +481,9 @@ void irqchip_cpu_reset(struct per_cpu *cpu_data)
 void irqchip_cpu_shutdown(struct public_per_cpu *cpu_public)
 {
 	struct pending_irqs *pending = &cpu_public->pending_irqs;
+	unsigned int n;
 	int irq_id;
+	u32 entry;
 
 	/*
 	 * The GIC implementation must take care of only resetting the hyp
@@ -398,17 +507,24 @@ void irqchip_cpu_shutdown(struct public_per_cpu *cpu_public)
 
 	/* Migrate interrupts queued in software. */
 	while (pending->head != pending->tail) {
-		irq_id = pending->irqs[pending->head];
+		n = pending->head % MAX_PENDING_IRQS;
+		entry = pending->entries[n];
+		if (entry)
+			irqchip.inject_phys_irq(PENDING_ENTRY_IRQ(entry));
+		pending->entries[n] = 0;
+		pending->head++;
+	}
 
-		irqchip.inject_phys_irq(irq_id);
+	for (n = 0; n < 16 * MAX_OVERFLOW_SGI_SENDERS; n++)
+		if (test_bit(n, pending->overflow_sgis))
+			irqchip.inject_phys_irq(n / MAX_OVERFLOW_SGI_SENDERS);
+	for (n = 0; n < MAX_OVERFLOW_IRQS; n++)
+		if (test_bit(n, pending->overflow_irqs))
+			irqchip.inject_phys_irq(n);
 
-		/*
-		 * Ensure that the entry was read before updating the head
-		 * index.
-		 */
-		memory_barrier();
-		pending->head = (pending->head + 1) % MAX_PENDING_IRQS;
-	}
+	memset(pending->overflow_sgis, 0, sizeof(pending->overflow_sgis));
+	memset(pending->overflow_irqs, 0, sizeof(pending->overflow_irqs));
+	pending->overflowed = false;
 }
 
 static int irqchip_cell_init(struct cell *cell)
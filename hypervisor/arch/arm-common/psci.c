@@ -13,6 +13,7 @@
  */
 
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <asm/control.h>
 #include <asm/psci.h>
 #include <asm/smccc.h>
@@ -94,6 +95,7 @@ static long psci_emulate_features_info(struct trap_context *ctx)
 long psci_dispatch(struct trap_context *ctx)
 {
 	this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VMEXITS_PSCI]++;
+	latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_PSCI);
 
 	switch (ctx->regs[0]) {
 	case PSCI_0_2_FN_VERSION:
@@ -11,6 +11,7 @@
  */
 
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/printk.h>
 #include <asm/psci.h>
 #include <asm/traps.h>
@@ -123,11 +124,13 @@ enum trap_return handle_smc(struct trap_context *ctx)
 	switch (SMCCC_GET_OWNER(regs[0])) {
 	case ARM_SMCCC_OWNER_ARCH:
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_SMCCC]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_SMCCC);
 		ret = handle_arch(ctx);
 		break;
 
 	case ARM_SMCCC_OWNER_SIP:
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_SMCCC]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_SMCCC);
 		regs[0] = ARM_SMCCC_NOT_SUPPORTED;
 		break;
 
@@ -42,3 +42,49 @@ static inline int atomic_test_and_set_bit(int nr, volatile unsigned long *addr)
 
 	return !!(test);
 }
+
+static inline int atomic_test_and_clear_bit(int nr,
+					    volatile unsigned long *addr)
+{
+	unsigned long ret, val, test;
+
+	/* word-align */
+	addr = (unsigned long *)((u32)addr & ~0x3) + nr / BITS_PER_LONG;
+	nr %= BITS_PER_LONG;
+
+	do {
+		asm volatile (
+			"ldrex	%1, %3\n\t"
+			"ands	%2, %1, %4\n\t"
+			"it	ne\n\t"
+			"bicne	%1, %4\n\t"
+			"strex	%0, %1, %3\n\t"
+			: "=r" (ret), "=r" (val), "=r" (test),
+			  "+Qo" (*(volatile unsigned long *)addr)
+			: "r" (1 << nr));
+	} while (ret);
+
+	return !!(test);
+}
+
+/* Returns the value found at *addr, the exchange succeeded if it was old */
+static inline unsigned int atomic_cmpxchg(volatile unsigned int *addr,
+					  unsigned int old, unsigned int new)
+{
+	unsigned int prev, ret;
+
+	do {
+		asm volatile (
+			"mov	%0, #0\n\t"
+			"ldrex	%1, %2\n\t"
+			"teq	%1, %3\n\t"
+			"it	eq\n\t"
+			"strexeq	%0, %4, %2\n\t"
+			: "=&r" (ret), "=&r" (prev), "+Qo" (*addr)
+			: "r" (old), "r" (new)
+			: "cc", "memory");
+	} while (ret);
+	asm volatile("dmb ish" : : : "memory");
+
+	return prev;
+}
@@ -221,6 +221,17 @@ static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 	}
 }
 
+static inline void arch_paging_flush_all_tlbs(void)
+{
+	/* see arch_paging_flush_page_tlbs */
+	if (is_el2()) {
+		dsb();
+		arm_write_sysreg(TLBIALLH, 1);
+		dsb();
+		isb();
+	}
+}
+
 /* Used to clean the PAGING_COHERENT page table changes */
 static inline void arch_paging_flush_cpu_caches(void *addr, long size)
 {
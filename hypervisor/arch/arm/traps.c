@@ -15,6 +15,7 @@
  */
 
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/printk.h>
 #include <asm/control.h>
 #include <asm/gic.h>
@@ -295,6 +296,7 @@ static enum trap_return arch_handle_cp15_32(struct trap_context *ctx)
 })
 
 	this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VMEXITS_CP15]++;
+	latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_CP15);
 
 	if (!read)
 		access_cell_reg(ctx, rt, &val, true);
@@ -378,6 +380,7 @@ static enum trap_return arch_handle_cp15_64(struct trap_context *ctx)
 })
 
 	this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VMEXITS_CP15]++;
+	latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_CP15);
 
 	/* all regs are write-only / only trapped on writes */
 	if (read)
@@ -488,6 +491,7 @@ static void arch_dump_abt(bool is_data)
 union registers* arch_handle_exit(union registers *regs)
 {
 	this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VMEXITS_TOTAL]++;
+	latency_exit_begin();
 
 	switch (regs->exit_reason) {
 	case EXIT_REASON_IRQ:
@@ -519,5 +523,7 @@ union registers* arch_handle_exit(union registers *regs)
 		panic_stop();
 	}
 
+	latency_exit_end();
+
 	return regs;
 }
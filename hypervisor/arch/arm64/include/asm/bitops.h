@@ -43,3 +43,53 @@ static inline int atomic_test_and_set_bit(int nr, volatile unsigned long *addr)
 	} while (ret);
 	return !!(test);
 }
+
+static inline int atomic_test_and_clear_bit(int nr,
+					    volatile unsigned long *addr)
+{
+	u32 ret;
+	u64 test, tmp;
+
+	/* word-align */
+	addr = (unsigned long *)((u64)addr & ~0x7) + nr / BITS_PER_LONG;
+	nr %= BITS_PER_LONG;
+
+	do {
+		asm volatile (
+			"ldxr	%3, %2\n\t"
+			"ands	%1, %3, %4\n\t"
+			"b.eq	1f\n\t"
+			"bic	%3, %3, %4\n\t"
+			"1:\n\t"
+			"stxr	%w0, %3, %2\n\t"
+			"dmb    ish\n\t"
+			: "=&r" (ret), "=&r" (test),
+			  "+Q" (*(volatile unsigned long *)addr),
+			  "=&r" (tmp)
+			: "r" (1ul << nr));
+	} while (ret);
+	return !!(test);
+}
+
+/* Returns the value found at *addr, the exchange succeeded if it was old */
+static inline unsigned int atomic_cmpxchg(volatile unsigned int *addr,
+					  unsigned int old, unsigned int new)
+{
+	unsigned int prev;
+	u32 ret;
+
+	do {
+		asm volatile (
+			"mov	%w0, #0\n\t"
+			"ldxr	%w1, %2\n\t"
+			"cmp	%w1, %w3\n\t"
+			"b.ne	1f\n\t"
+			"stxr	%w0, %w4, %2\n\t"
+			"1:\n\t"
+			"dmb    ish\n\t"
+			: "=&r" (ret), "=&r" (prev), "+Q" (*addr)
+			: "r" (old), "r" (new)
+			: "cc", "memory");
+	} while (ret);
+	return prev;
+}
@@ -223,6 +223,15 @@ static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 		: : "r" (page_addr >> PAGE_SHIFT));
 }
 
+static inline void arch_paging_flush_all_tlbs(void)
+{
+	asm volatile(
+		"dsb ish\n\t"
+		"tlbi alle2\n\t"
+		"dsb ish\n\t"
+		"isb\n\t");
+}
+
 /* Used to clean the PAGE_MAP_COHERENT page table changes */
 static inline void arch_paging_flush_cpu_caches(void *addr, long size)
 {
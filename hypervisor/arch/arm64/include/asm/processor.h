@@ -14,6 +14,7 @@
 #define _JAILHOUSE_ASM_PROCESSOR_H
 
 #include <jailhouse/types.h>
+#include <asm/sysregs.h>
 
 /* also include from arm-common */
 #include_next <asm/processor.h>
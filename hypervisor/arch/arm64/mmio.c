@@ -16,6 +16,7 @@
 
 #include <jailhouse/bitops.h>
 #include <jailhouse/entry.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/mmio.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/percpu.h>
@@ -63,6 +64,7 @@ enum trap_return arch_handle_dabt(struct trap_context *ctx)
 	mmio.address |= hdfar & 0xfff;
 
 	this_cpu_public()->stats[JAILHOUSE_CPU_STAT_VMEXITS_MMIO]++;
+	latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MMIO);
 
 	/*
 	 * Invalid instruction syndrome means multiple access or writeback,
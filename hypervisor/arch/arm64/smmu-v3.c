@@ -276,6 +276,10 @@
 #define CMDQ_OP_TLBI_NSNH_ALL	0x30
 #define CMDQ_OP_CMD_SYNC	0x46
 #define ARM_SMMU_FEAT_2_LVL_STRTAB	(1 << 0)
+#define ARM_SMMU_FEAT_MSIPOLL		(1 << 2)
+
+/* Number of MSI polls between checks for command queue errors */
+#define CMDQ_MSI_POLL_ERR_INTERVAL	1024
 
 /* High-level queue structures */
 struct arm_smmu_cmdq_ent {
@@ -329,6 +333,9 @@ struct arm_smmu_queue {
 struct arm_smmu_cmdq {
 	struct arm_smmu_queue		q;
 	spinlock_t			lock;
+	/* CMD_SYNC completion word, written by the SMMU via MSI */
+	volatile u32			sync_msi_data;
+	u32				sync_count;
 };
 
 struct arm_smmu_evtq {
@@ -400,6 +407,10 @@ static void queue_inc_prod(struct arm_smmu_queue *q)
 	u32 prod = (Q_WRP(q->prod, shift) | Q_IDX(q->prod, shift)) + 1;
 
 	q->prod = Q_OVF(q->prod) | Q_WRP(prod, shift) | Q_IDX(prod, shift);
+}
+
+static void queue_publish_prod(struct arm_smmu_queue *q)
+{
 	mmio_write32(q->prod_reg, q->prod);
 }
 
@@ -500,23 +511,43 @@ static void arm_smmu_cmdq_skip_err(struct arm_smmu_device *smmu)
 	mmio_write32(smmu->base + ARM_SMMU_GERRORN, gerrorn);
 }
 
+/*
+ * Commands are submitted in batches: Between arm_smmu_cmdq_batch_begin() and
+ * arm_smmu_cmdq_batch_commit(), arm_smmu_cmdq_batch_add() only writes commands
+ * to the queue. The commit publishes them at once, terminated by a single
+ * CMD_SYNC, and waits for the completion of that CMD_SYNC.
+ */
+static void arm_smmu_cmdq_batch_begin(struct arm_smmu_device *smmu)
+{
+	spin_lock(&smmu->cmdq.lock);
+}
+
+static void arm_smmu_cmdq_poll_cons(struct arm_smmu_device *smmu)
+{
+	struct arm_smmu_queue *q = &smmu->cmdq.q;
+
+	queue_sync_cons(q);
+	if (queue_error(smmu, q))
+		arm_smmu_cmdq_skip_err(smmu);
+}
+
 static void arm_smmu_cmdq_insert_cmd(struct arm_smmu_device *smmu, u64 *cmd)
 {
 	struct arm_smmu_queue *q = &smmu->cmdq.q;
 
-	while (queue_full(q))
-		queue_sync_cons(q);
+	if (queue_full(q)) {
+		/* let the SMMU consume what we have queued so far */
+		queue_publish_prod(q);
+		do
+			arm_smmu_cmdq_poll_cons(smmu);
+		while (queue_full(q));
+	}
 
 	queue_write(queue_entry(q, q->prod), cmd, q->ent_dwords);
 	queue_inc_prod(q);
-	while (!queue_empty(q)) {
-		queue_sync_cons(q);
-		if (queue_error(smmu, q))
-			arm_smmu_cmdq_skip_err(smmu);
-	}
 }
 
-static void arm_smmu_cmdq_issue_cmd(struct arm_smmu_device *smmu,
+static void arm_smmu_cmdq_batch_add(struct arm_smmu_device *smmu,
 				    struct arm_smmu_cmdq_ent *ent)
 {
 	u64 cmd[CMDQ_ENT_DWORDS];
@@ -525,20 +556,52 @@ static void arm_smmu_cmdq_issue_cmd(struct arm_smmu_device *smmu,
 		/* Ignore any unknown command */
 		return;
 
-	spin_lock(&smmu->cmdq.lock);
 	arm_smmu_cmdq_insert_cmd(smmu, cmd);
-	spin_unlock(&smmu->cmdq.lock);
 }
 
-static void arm_smmu_cmdq_issue_sync(struct arm_smmu_device *smmu)
+static bool arm_smmu_cmdq_sync_done(struct arm_smmu_device *smmu)
+{
+	return (s32)(smmu->cmdq.sync_msi_data - smmu->cmdq.sync_count) >= 0;
+}
+
+static void arm_smmu_cmdq_batch_commit(struct arm_smmu_device *smmu)
 {
 	struct arm_smmu_cmdq_ent ent = { .opcode = CMDQ_OP_CMD_SYNC };
-	u64 cmd[CMDQ_ENT_DWORDS];
+	struct arm_smmu_queue *q = &smmu->cmdq.q;
+	unsigned int polls = 0;
 
-	arm_smmu_cmdq_build_cmd(cmd, &ent);
+	/*
+	 * If the SMMU can write the completion to coherent memory, poll that
+	 * instead of the CONS register.
+	 */
+	if (smmu->features & ARM_SMMU_FEAT_MSIPOLL) {
+		ent.sync.msiaddr = paging_hvirt2phys(&smmu->cmdq.sync_msi_data);
+		ent.sync.msidata = ++smmu->cmdq.sync_count;
+	}
+
+	arm_smmu_cmdq_batch_add(smmu, &ent);
+	queue_publish_prod(q);
+
+	if (smmu->features & ARM_SMMU_FEAT_MSIPOLL) {
+		while (!arm_smmu_cmdq_sync_done(smmu)) {
+			/*
+			 * A faulting command stalls the queue, and the
+			 * CMD_SYNC may even be replaced on error. Check for
+			 * this from time to time.
+			 */
+			if (++polls % CMDQ_MSI_POLL_ERR_INTERVAL == 0) {
+				arm_smmu_cmdq_poll_cons(smmu);
+				if (queue_empty(q))
+					break;
+			}
+			cpu_relax();
+		}
+		queue_sync_cons(q);
+	} else {
+		while (!queue_empty(q))
+			arm_smmu_cmdq_poll_cons(smmu);
+	}
 
-	spin_lock(&smmu->cmdq.lock);
-	arm_smmu_cmdq_insert_cmd(smmu, cmd);
 	spin_unlock(&smmu->cmdq.lock);
 }
 
@@ -556,20 +619,29 @@ arm_smmu_write_strtab_l1_desc(u64 *dst, struct arm_smmu_strtab_l1_desc *desc)
 	dsb(ishst);
 }
 
-static void arm_smmu_sync_ste_for_sid(struct arm_smmu_device *smmu, u32 sid)
+static void arm_smmu_queue_cfgi_ste(struct arm_smmu_device *smmu, u32 sid,
+				    bool leaf)
 {
 	struct arm_smmu_cmdq_ent cmd = {
 		.opcode	= CMDQ_OP_CFGI_STE,
 		.cfgi	= {
 			.sid	= sid,
-			.leaf	= true,
+			.leaf	= leaf,
 		},
 	};
 
-	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
-	arm_smmu_cmdq_issue_sync(smmu);
+	arm_smmu_cmdq_batch_add(smmu, &cmd);
 }
 
+/*
+ * Write a stream table entry. If smmu is provided, the invalidation of the
+ * STE is queued into the currently open command batch.
+ *
+ * For translating STEs, only the configuration dwords are written and
+ * invalidated. arm_smmu_enable_strtab_ent has to be called for the entry
+ * after the batch was committed, so that the SMMU observes the new
+ * configuration before the updated first dword.
+ */
 static void arm_smmu_write_strtab_ent(struct arm_smmu_device *smmu, u32 sid,
 				      u64 *guest_ste, u64 *dst, bool bypass,
 				      u32 vmid)
@@ -589,7 +661,7 @@ static void arm_smmu_write_strtab_ent(struct arm_smmu_device *smmu, u32 sid,
 		dst[0] = val;
 		dsb(ishst);
 		if (smmu)
-			arm_smmu_sync_ste_for_sid(smmu, sid);
+			arm_smmu_queue_cfgi_ste(smmu, sid, true);
 		return;
 	}
 
@@ -600,14 +672,22 @@ static void arm_smmu_write_strtab_ent(struct arm_smmu_device *smmu, u32 sid,
 
 	vttbr = paging_hvirt2phys(pg_structs->root_table);
 	dst[3] = vttbr & STRTAB_STE_3_S2TTB_MASK;
+	dsb(ishst);
+
+	arm_smmu_queue_cfgi_ste(smmu, sid, true);
+}
+
+static void arm_smmu_enable_strtab_ent(struct arm_smmu_device *smmu, u32 sid,
+				       u64 *dst)
+{
+	u64 val = 0;
 
 	val |= FIELD_PREP(STRTAB_STE_0_CFG, STRTAB_STE_0_CFG_S2_TRANS);
 	val |= STRTAB_STE_0_V;
 
-	arm_smmu_sync_ste_for_sid(smmu, sid);
 	dst[0] = val;
 	dsb(ishst);
-	arm_smmu_sync_ste_for_sid(smmu, sid);
+	arm_smmu_queue_cfgi_ste(smmu, sid, true);
 }
 
 static void arm_smmu_init_bypass_stes(u64 *strtab, unsigned int nent)
@@ -843,18 +923,19 @@ static int arm_smmu_device_reset(struct arm_smmu_device *smmu)
 	if (ret)
 		return ret;
 
+	arm_smmu_cmdq_batch_begin(smmu);
+
 	/* Invalidate any cached configuration */
 	cmd.opcode = CMDQ_OP_CFGI_ALL;
-	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
-	arm_smmu_cmdq_issue_sync(smmu);
-
-	cmd.opcode = CMDQ_OP_TLBI_NSNH_ALL;
-	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
+	arm_smmu_cmdq_batch_add(smmu, &cmd);
 
 	/* Invalidate any stale TLB entries */
+	cmd.opcode = CMDQ_OP_TLBI_NSNH_ALL;
+	arm_smmu_cmdq_batch_add(smmu, &cmd);
 	cmd.opcode = CMDQ_OP_TLBI_EL2_ALL;
-	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
-	arm_smmu_cmdq_issue_sync(smmu);
+	arm_smmu_cmdq_batch_add(smmu, &cmd);
+
+	arm_smmu_cmdq_batch_commit(smmu);
 
 	/* Event queue */
 	mmio_write64(smmu->base + ARM_SMMU_EVTQ_BASE, smmu->evtq.q.q_base);
@@ -897,6 +978,10 @@ static int arm_smmu_device_init_features(struct arm_smmu_device *smmu)
 	if (FIELD_GET(IDR0_VMID16, reg))
 		smmu->features |= IDR0_VMID16;
 
+	/* MSI-based CMD_SYNC completion requires coherent writes */
+	if ((reg & IDR0_MSI) && (reg & IDR0_COHACC))
+		smmu->features |= ARM_SMMU_FEAT_MSIPOLL;
+
 	/* IDR1 */
 	reg = mmio_read32(smmu->base + ARM_SMMU_IDR1);
 	if (reg & (IDR1_TABLES_PRESET | IDR1_QUEUES_PRESET | IDR1_REL))
@@ -928,7 +1013,6 @@ static int arm_smmu_init_l2_strtab(struct arm_smmu_device *smmu, u32 sid)
 {
 	struct arm_smmu_strtab_cfg *cfg = &smmu->strtab_cfg;
 	struct arm_smmu_strtab_l1_desc *desc;
-	struct arm_smmu_cmdq_ent cmd;
 	void *strtab;
 	u32 size;
 
@@ -952,10 +1036,7 @@ static int arm_smmu_init_l2_strtab(struct arm_smmu_device *smmu, u32 sid)
 	arm_smmu_write_strtab_l1_desc(strtab, desc);
 
 	/* Invalidate cached L1 descriptors. */
-	cmd.opcode = CMDQ_OP_CFGI_STE;
-	cmd.cfgi.sid = sid;
-	cmd.cfgi.leaf = false;
-	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
+	arm_smmu_queue_cfgi_ste(smmu, sid, false);
 
 	return 0;
 }
@@ -964,7 +1045,6 @@ static void arm_smmu_uninit_l2_strtab(struct arm_smmu_device *smmu, u32 sid)
 {
 	struct arm_smmu_strtab_cfg *cfg = &smmu->strtab_cfg;
 	struct arm_smmu_strtab_l1_desc *desc;
-	struct arm_smmu_cmdq_ent cmd;
 	void *strtab;
 	u32 size;
 
@@ -981,10 +1061,7 @@ static void arm_smmu_uninit_l2_strtab(struct arm_smmu_device *smmu, u32 sid)
 	arm_smmu_write_strtab_l1_desc(strtab, desc);
 
 	/* Invalidate cached L1 descriptors. */
-	cmd.opcode = CMDQ_OP_CFGI_STE;
-	cmd.cfgi.sid = sid;
-	cmd.cfgi.leaf = false;
-	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
+	arm_smmu_queue_cfgi_ste(smmu, sid, false);
 
 	size = 1 << (STRTAB_SPLIT + STRTAB_STE_DWORDS_BITS + 3);
 	page_free(&mem_pool, desc->l2ptr, PAGES(size));
@@ -1047,7 +1124,8 @@ static int arm_smmuv3_cell_init(struct cell *cell)
 	struct arm_smmu_cmdq_ent cmd;
 	union jailhouse_stream_id sid;
 	unsigned int n, s;
-	int ret;
+	int ret = 0;
+	u64 *step;
 
 	if (!iommu_count_units())
 		return 0;
@@ -1057,16 +1135,30 @@ static int arm_smmuv3_cell_init(struct cell *cell)
 		if (iommu->type != JAILHOUSE_IOMMU_SMMUV3)
 			continue;
 
+		/*
+		 * Update the STEs of all streams in two batches: first the
+		 * configuration, then the enabling first dword.
+		 */
+		arm_smmu_cmdq_batch_begin(smmu);
 		for_each_stream_id(sid, cell->config, s) {
 			ret = arm_smmu_init_ste(smmu, sid.id, cell->config->id);
 			if (ret)
-				return ret;
+				break;
+		}
+		arm_smmu_cmdq_batch_commit(smmu);
+		if (ret)
+			return ret;
+
+		arm_smmu_cmdq_batch_begin(smmu);
+		for_each_stream_id(sid, cell->config, s) {
+			step = arm_smmu_get_step_for_sid(smmu, sid.id);
+			arm_smmu_enable_strtab_ent(smmu, sid.id, step);
 		}
 
 		cmd.opcode	= CMDQ_OP_TLBI_S12_VMALL;
 		cmd.tlbi.vmid	= cell->config->id;
-		arm_smmu_cmdq_issue_cmd(smmu, &cmd);
-		arm_smmu_cmdq_issue_sync(smmu);
+		arm_smmu_cmdq_batch_add(smmu, &cmd);
+		arm_smmu_cmdq_batch_commit(smmu);
 	}
 
 	return 0;
@@ -1088,14 +1180,15 @@ static void arm_smmuv3_cell_exit(struct cell *cell)
 		if (iommu->type != JAILHOUSE_IOMMU_SMMUV3)
 			continue;
 
+		arm_smmu_cmdq_batch_begin(smmu);
 		for_each_stream_id(sid, cell->config, s) {
 			arm_smmu_uninit_ste(smmu, sid.id, cell->config->id);
 		}
 
 		cmd.opcode	= CMDQ_OP_TLBI_S12_VMALL;
 		cmd.tlbi.vmid	= cell->config->id;
-		arm_smmu_cmdq_issue_cmd(smmu, &cmd);
-		arm_smmu_cmdq_issue_sync(smmu);
+		arm_smmu_cmdq_batch_add(smmu, &cmd);
+		arm_smmu_cmdq_batch_commit(smmu);
 	}
 }
 
@@ -12,6 +12,7 @@
  */
 
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/printk.h>
 #include <asm/control.h>
 #include <asm/entry.h>
@@ -176,6 +177,8 @@ void arch_handle_trap(union registers *guest_regs)
 	trap_handler handler;
 	int ret = TRAP_UNHANDLED;
 
+	latency_exit_begin();
+
 	fill_trap_context(&ctx, guest_regs);
 
 	handler = trap_handlers[ESR_EC(ctx.esr)];
@@ -191,6 +194,15 @@ void arch_handle_trap(union registers *guest_regs)
 		dump_regs(&ctx);
 		panic_park();
 	}
+
+	latency_exit_end();
+}
+
+void arch_handle_irq(union registers *guest_regs)
+{
+	latency_exit_begin();
+	irqchip_handle_irq();
+	latency_exit_end();
 }
 
 void arch_el2_abt(union registers *regs)
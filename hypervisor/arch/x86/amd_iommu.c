@@ -107,6 +107,11 @@ union buf_entry {
 # define CMD_INV_IOMMU_PAGES_SIZE	(1 << 0)
 # define CMD_INV_IOMMU_PAGES_PDE	(1 << 1)
 
+/* Maximum number of range invalidations before flushing the whole domain */
+#define AMD_IOMMU_MAX_INV_REQUESTS	32
+/* Largest range order that is covered by 4-level page tables */
+#define AMD_IOMMU_MAX_INV_ORDER		(48 - PAGE_SHIFT)
+
 #define EVENT_TYPE_ILL_DEV_TAB_ENTRY	0x01
 #define EVENT_TYPE_PAGE_TAB_HW_ERR	0x04
 #define EVENT_TYPE_ILL_CMD_ERR		0x05
@@ -219,13 +224,15 @@ int iommu_map_memory_region(struct cell *cell,
 		return trace_error(-E2BIG);
 
 	/* vcpu_map_memory_region already did the actual work. */
+	iommu_record_inv_range(cell, mem->virt_start, mem->size);
 	return 0;
 }
 
 int iommu_unmap_memory_region(struct cell *cell,
 			      const struct jailhouse_memory *mem)
 {
-	/* vcpu_map_memory_region already did the actual work. */
+	/* vcpu_unmap_memory_region will do the actual work. */
+	iommu_record_inv_range(cell, mem->virt_start, mem->size);
 	return 0;
 }
 
@@ -343,6 +350,8 @@ int iommu_add_pci_device(struct cell *cell, struct pci_device *device)
 
 	amd_iommu_inv_dte(iommu, bdf);
 
+	cell->arch.iommu_inv.domain = true;
+
 	return 0;
 }
 
@@ -376,6 +385,9 @@ void iommu_remove_pci_device(struct pci_device *device)
 	arch_paging_flush_cpu_caches(dte, sizeof(*dte));
 
 	amd_iommu_inv_dte(iommu, bdf);
+
+	if (device->cell)
+		device->cell->arch.iommu_inv.domain = true;
 }
 
 static void amd_iommu_cell_exit(struct cell *cell)
@@ -389,29 +401,110 @@ static void wait_for_zero(volatile u64 *sem, unsigned long mask)
 }
 
 static void amd_iommu_invalidate_pages(struct amd_iommu *iommu,
-				       u16 domain_id)
+				       u16 domain_id, u64 addr, bool size)
 {
 	union buf_entry invalidate_pages = {{ 0 }};
 
+	invalidate_pages.raw32[1] = domain_id;
+	invalidate_pages.raw32[2] = (addr & BIT_MASK(31, 12)) |
+		CMD_INV_IOMMU_PAGES_PDE | (size ? CMD_INV_IOMMU_PAGES_SIZE : 0);
+	invalidate_pages.raw32[3] = addr >> 32;
+	invalidate_pages.type = CMD_INV_IOMMU_PAGES;
+
+	amd_iommu_submit_command(iommu, &invalidate_pages, false);
+}
+
+static void amd_iommu_invalidate_domain(struct amd_iommu *iommu,
+					u16 domain_id)
+{
 	/*
 	 * Flush everything, including PDEs, in whole address range, i.e.
 	 * 0x7ffffffffffff000 with S bit (see Sect. 2.2.3).
 	 */
-	invalidate_pages.raw32[1] = domain_id;
-	invalidate_pages.raw32[2] = 0xfffff000 | CMD_INV_IOMMU_PAGES_SIZE |
-		CMD_INV_IOMMU_PAGES_PDE;
-	invalidate_pages.raw32[3] = 0x7fffffff;
-	invalidate_pages.type = CMD_INV_IOMMU_PAGES;
+	amd_iommu_invalidate_pages(iommu, domain_id, 0x7ffffffffffff000UL,
+				   true);
+}
 
-	amd_iommu_submit_command(iommu, &invalidate_pages, false);
+static void amd_iommu_invalidate_range(struct amd_iommu *iommu,
+				       u16 domain_id, unsigned long addr,
+				       unsigned int order)
+{
+	/*
+	 * With the S bit set, the lowest clear address bit above bit 11
+	 * determines the size of the naturally aligned range, starting with
+	 * 8K for bit 12. PDEs are always included as page tables may have
+	 * been freed or split.
+	 */
+	if (order > 0)
+		addr |= ((PAGE_SIZE << order) - 1) >> 1;
+	amd_iommu_invalidate_pages(iommu, domain_id, addr, order > 0);
 }
 
-static void amd_iommu_completion_wait(struct amd_iommu *iommu)
+static void amd_iommu_invalidate_cell_ranges(struct amd_iommu *iommu,
+					     struct cell *cell)
 {
-	long addr = paging_hvirt2phys(&per_cpu(this_cpu_id())->amd_iommu_sem);
+	u16 domain_id = cell->config->id & 0xffff;
+	unsigned long addr, end;
+	unsigned int n, order;
+
+	for (n = 0; n < cell->arch.iommu_inv.num_ranges; n++) {
+		addr = cell->arch.iommu_inv.ranges[n].start;
+		end = addr + cell->arch.iommu_inv.ranges[n].size;
+		while (addr < end) {
+			order = iommu_inv_order(addr, end,
+						AMD_IOMMU_MAX_INV_ORDER);
+			amd_iommu_invalidate_range(iommu, domain_id, addr,
+						   order);
+			addr += PAGE_SIZE << order;
+		}
+	}
+}
+
+/*
+ * Queue invalidations for the translations of a cell that changed since the
+ * last commit on all IOMMUs. Only the modified ranges are invalidated if their
+ * number is reasonably small.
+ */
+static void amd_iommu_queue_cell_flush(struct cell *cell)
+{
+	u32 *stats = this_cpu_public()->stats;
+	unsigned int requests = 0;
+	struct amd_iommu *iommu;
+
+	if (!cell->arch.iommu_inv.domain &&
+	    cell->arch.iommu_inv.num_ranges == 0)
+		return;
+
+	if (!cell->arch.iommu_inv.domain)
+		requests = iommu_inv_requests(cell, AMD_IOMMU_MAX_INV_ORDER);
+
+	if (requests > 0 && requests <= AMD_IOMMU_MAX_INV_REQUESTS) {
+		for_each_iommu(iommu)
+			amd_iommu_invalidate_cell_ranges(iommu, cell);
+		stats[JAILHOUSE_CPU_STAT_IOMMU_INV_PAGE] += requests;
+	} else {
+		for_each_iommu(iommu)
+			amd_iommu_invalidate_domain(iommu,
+						    cell->config->id & 0xffff);
+		stats[JAILHOUSE_CPU_STAT_IOMMU_INV_DOMAIN]++;
+	}
+
+	cell->arch.iommu_inv.domain = false;
+	cell->arch.iommu_inv.num_ranges = 0;
+}
+
+/*
+ * Append a COMPLETION_WAIT to the queued commands and hand all of them over to
+ * the IOMMU without waiting for their execution.
+ */
+static void amd_iommu_completion_wait_start(struct amd_iommu *iommu)
+{
+	unsigned int unit = iommu - iommu_units;
+	long addr =
+		paging_hvirt2phys(&per_cpu(this_cpu_id())->amd_iommu_sem[unit]);
 	union buf_entry completion_wait = {{ 0 }};
 
-	this_cpu_data()->amd_iommu_sem = 1;
+	this_cpu_data()->amd_iommu_sem[unit] = 1;
 
 	completion_wait.raw32[0] = (addr & BIT_MASK(31, 3)) |
 		CMD_COMPL_WAIT_STORE;
@@ -421,8 +514,18 @@ static void amd_iommu_completion_wait(struct amd_iommu *iommu)
 	amd_iommu_submit_command(iommu, &completion_wait, true);
 	mmio_write64(iommu->mmio_base + AMD_CMD_BUF_TAIL_REG,
 		     iommu->cmd_tail_ptr);
+}
 
-	wait_for_zero(&this_cpu_data()->amd_iommu_sem, -1);
+static void amd_iommu_completion_wait_finish(struct amd_iommu *iommu)
+{
+	wait_for_zero(&this_cpu_data()->amd_iommu_sem[iommu - iommu_units],
+		      -1);
+}
+
+static void amd_iommu_completion_wait(struct amd_iommu *iommu)
+{
+	amd_iommu_completion_wait_start(iommu);
+	amd_iommu_completion_wait_finish(iommu);
 }
 
 static void amd_iommu_init_fault_nmi(void)
@@ -484,17 +587,19 @@ void iommu_config_commit(struct cell *cell_added_removed)
 	if (cell_added_removed)
 		amd_iommu_init_fault_nmi();
 
-	for_each_iommu(iommu) {
-		/* Flush caches */
-		if (cell_added_removed) {
-			amd_iommu_invalidate_pages(iommu,
-					cell_added_removed->config->id & 0xffff);
-			amd_iommu_invalidate_pages(iommu,
-					root_cell.config->id & 0xffff);
-		}
-		/* Execute all commands in the buffer */
-		amd_iommu_completion_wait(iommu);
-	}
+	/* Flush caches */
+	if (cell_added_removed)
+		amd_iommu_queue_cell_flush(cell_added_removed);
+	amd_iommu_queue_cell_flush(&root_cell);
+
+	/*
+	 * Execute all commands in the buffers. Let the IOMMUs process them in
+	 * parallel and only then wait for their completion.
+	 */
+	for_each_iommu(iommu)
+		amd_iommu_completion_wait_start(iommu);
+	for_each_iommu(iommu)
+		amd_iommu_completion_wait_finish(iommu);
 }
 
 struct apic_irq_message iommu_get_remapped_root_int(unsigned int iommu,
@@ -16,7 +16,9 @@
 #include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/mmio.h>
+#include <jailhouse/trace.h>
 #include <asm/apic.h>
 #include <asm/control.h>
 
@@ -277,6 +279,8 @@ void apic_send_irq(struct apic_irq_message irq_msg)
 		if (irq_msg.dest_logical && irq_msg.destination != 0)
 			irq_msg.destination = 1UL << ffsl(irq_msg.destination);
 	}
+	trace_point(JAILHOUSE_TRACE_IRQ, irq_msg.destination, irq_msg.vector,
+		    this_cpu_id());
 	apic_ops.send_ipi(irq_msg.destination,
 			  irq_msg.vector | delivery_mode |
 			  (irq_msg.dest_logical ? APIC_ICR_DEST_LOGICAL : 0) |
@@ -568,10 +572,12 @@ bool x2apic_handle_write(void)
 
 	if (reg == APIC_REG_ICR) {
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_X2APIC_ICR]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_X2APIC_ICR);
 		return apic_handle_icr_write(val, guest_regs->rdx);
 	}
 
 	stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER]++;
+	latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
 
 	if (reg == APIC_REG_SELF_IPI)
 		/* TODO: emulate */
@@ -598,9 +604,11 @@ void x2apic_handle_read(void)
 
 	if (reg == APIC_REG_ICR) {
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_X2APIC_ICR]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_X2APIC_ICR);
 		guest_regs->rdx = apic_ops.read(reg + 1);
 	} else {
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
 		guest_regs->rdx = 0;
 	}
 }
@@ -17,6 +17,8 @@
 
 #include <jailhouse/paging.h>
 
+#define IOMMU_MAX_INV_RANGES	16
+
 struct cell_ioapic;
 
 /** x86-specific cell states. */
@@ -47,9 +49,25 @@ struct arch_cell {
 			/** True if interrupt remapping support is emulated for this
 			 * cell. */
 			bool ir_emulation;
+			/** True if pg_structs refers to the cell's EPT. */
+			bool shared_pt;
 		} vtd; /**< Intel VT-d specific fields. */
 	};
 
+	/** IOMMU translations to be invalidated on the next config commit. */
+	struct {
+		/** True if the whole domain has to be invalidated, e.g. due to
+		 * device assignment changes. */
+		bool domain;
+		/** Number of valid entries in ranges. */
+		unsigned int num_ranges;
+		/** DMA address ranges changed since the last config commit. */
+		struct {
+			unsigned long start;
+			unsigned long size;
+		} ranges[IOMMU_MAX_INV_RANGES];
+	} iommu_inv;
+
 	/** Shadow value of PCI config space address port register. */
 	u32 pci_addr_port_val;
 
@@ -25,6 +25,12 @@ extern unsigned int fault_reporting_cpu_id;
 
 unsigned int iommu_count_units(void);
 
+void iommu_record_inv_range(struct cell *cell, unsigned long start,
+			    unsigned long size);
+unsigned int iommu_inv_order(unsigned long addr, unsigned long end,
+			     unsigned int max_order);
+unsigned int iommu_inv_requests(struct cell *cell, unsigned int max_order);
+
 int iommu_map_memory_region(struct cell *cell,
 			    const struct jailhouse_memory *mem);
 int iommu_unmap_memory_region(struct cell *cell,
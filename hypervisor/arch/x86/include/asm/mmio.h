@@ -37,6 +37,36 @@ struct mmio_instruction {
 	unsigned long reg_preserve_mask;
 };
 
+#define MMIO_INST_CACHE_ENTRIES		4
+
+/** Decoded MMIO instruction, as cached per CPU. */
+struct mmio_inst_cache_entry {
+	/** Guest paging mode and root table the instruction was fetched
+	 *  with. */
+	const struct paging *root_paging;
+	unsigned long root_table_gphys;
+	/** Guest instruction pointer. */
+	unsigned long rip;
+	/** EFER.LMA, CS.L and CS.D/B at decoding time. */
+	unsigned int mode;
+	/** Direction of the access. */
+	bool is_write;
+	/** Register providing the output value of a write, -1 if the value
+	 *  is an immediate. */
+	int out_reg_num;
+	/** Decoding result. */
+	struct mmio_instruction inst;
+};
+
+/** Per-CPU cache of decoded MMIO instructions. */
+struct mmio_inst_cache {
+	/** Number of valid entries. */
+	unsigned int valid;
+	/** Entry to be replaced next. */
+	unsigned int next;
+	struct mmio_inst_cache_entry entries[MMIO_INST_CACHE_ENTRIES];
+};
+
 /**
  * Parse instruction causing an intercepted MMIO access on a cell CPU.
  * @param pg_structs	Currently active guest (cell) paging structures.
@@ -44,8 +74,18 @@ struct mmio_instruction {
  *
  * @return MMIO instruction information. mmio_instruction::inst_len is 0 on
  * 	   invalid or unsupported access.
+ *
+ * @note If the cell has JAILHOUSE_CELL_MMIO_DECODE_CACHE set, the result is
+ * cached per CPU and reused for the same guest paging root, instruction
+ * pointer, CPU mode and access direction, skipping both the instruction fetch
+ * and the decoding.
  */
 struct mmio_instruction
 x86_mmio_parse(const struct guest_paging_structures *pg_structs, bool is_write);
 
+/**
+ * Invalidate the MMIO instruction cache of the calling CPU.
+ */
+void x86_mmio_inst_cache_flush(void);
+
 /** @} */
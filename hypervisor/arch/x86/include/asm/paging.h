@@ -59,6 +59,12 @@ static inline void arch_paging_flush_page_tlbs(unsigned long page_addr)
 	asm volatile("invlpg (%0)" : : "r" (page_addr));
 }
 
+static inline void arch_paging_flush_all_tlbs(void)
+{
+	/* the hypervisor does not use global pages */
+	write_cr3(read_cr3());
+}
+
 extern unsigned long cache_line_size;
 
 static inline void arch_paging_flush_cpu_caches(void *addr, long size)
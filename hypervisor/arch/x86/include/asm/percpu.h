@@ -79,10 +79,13 @@
 	/** Cached PDPTEs, used by VMX for PAE guest paging mode. */	\
 	unsigned long pdpte[4];						\
 									\
+	/** Recently decoded MMIO instructions. */			\
+	struct mmio_inst_cache mmio_inst_cache;				\
+									\
 	/* IOMMU request completion flags */				\
 	union {								\
-		volatile u32 vtd_iq_completed;				\
-		volatile u64 amd_iommu_sem;				\
+		volatile u32 vtd_iq_completed[JAILHOUSE_MAX_IOMMU_UNITS]; \
+		volatile u64 amd_iommu_sem[JAILHOUSE_MAX_IOMMU_UNITS];	\
 	};								\
 									\
 	/** True when CPU is initialized by hypervisor. */		\
@@ -325,6 +325,14 @@ static inline void write_msr(unsigned int msr, unsigned long val)
 		: "memory");
 }
 
+static inline u64 arch_read_timestamp(void)
+{
+	u32 low, high;
+
+	asm volatile("rdtsc" : "=a" (low), "=d" (high));
+	return low | ((u64)high << 32);
+}
+
 static inline void set_rdmsr_value(union registers *regs, unsigned long val)
 {
 	regs->rax = (u32)val;
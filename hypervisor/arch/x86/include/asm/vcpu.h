@@ -59,6 +59,7 @@ void __attribute__((noreturn)) vcpu_activate_vmm(void);
 void __attribute__((noreturn)) vcpu_deactivate_vmm(void);
 
 void vcpu_handle_exit(struct per_cpu *cpu_data);
+void vcpu_vendor_handle_exit(struct per_cpu *cpu_data);
 
 void vcpu_park(void);
 
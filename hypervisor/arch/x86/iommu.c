@@ -25,6 +25,69 @@ unsigned int iommu_count_units(void)
 	return units;
 }
 
+/*
+ * Remember a changed DMA address range of the cell so that the next config
+ * commit can invalidate it selectively. Falls back to invalidating the whole
+ * domain if the ranges cannot be tracked anymore.
+ */
+void iommu_record_inv_range(struct cell *cell, unsigned long start,
+			    unsigned long size)
+{
+	unsigned int n = cell->arch.iommu_inv.num_ranges;
+
+	if (cell->arch.iommu_inv.domain)
+		return;
+
+	if (n > 0 && cell->arch.iommu_inv.ranges[n - 1].start +
+	    cell->arch.iommu_inv.ranges[n - 1].size == start) {
+		cell->arch.iommu_inv.ranges[n - 1].size += size;
+	} else if (n < IOMMU_MAX_INV_RANGES) {
+		cell->arch.iommu_inv.ranges[n].start = start;
+		cell->arch.iommu_inv.ranges[n].size = size;
+		cell->arch.iommu_inv.num_ranges++;
+	} else {
+		cell->arch.iommu_inv.domain = true;
+	}
+}
+
+/*
+ * Return the page order of the largest naturally aligned block starting at
+ * addr that fits into [addr, end) and does not exceed max_order.
+ */
+unsigned int iommu_inv_order(unsigned long addr, unsigned long end,
+			     unsigned int max_order)
+{
+	unsigned int order = 0;
+
+	while (order < max_order &&
+	       (addr & ((PAGE_SIZE << (order + 1)) - 1)) == 0 &&
+	       addr + (PAGE_SIZE << (order + 1)) <= end)
+		order++;
+
+	return order;
+}
+
+/*
+ * Return the number of aligned block invalidations needed to cover all
+ * recorded ranges of the cell.
+ */
+unsigned int iommu_inv_requests(struct cell *cell, unsigned int max_order)
+{
+	unsigned int n, requests = 0;
+	unsigned long addr, end;
+
+	for (n = 0; n < cell->arch.iommu_inv.num_ranges; n++) {
+		addr = cell->arch.iommu_inv.ranges[n].start;
+		end = addr + cell->arch.iommu_inv.ranges[n].size;
+		while (addr < end) {
+			addr += PAGE_SIZE << iommu_inv_order(addr, end,
+							     max_order);
+			requests++;
+		}
+	}
+	return requests;
+}
+
 struct public_per_cpu *iommu_select_fault_reporting_cpu(void)
 {
 	/*
@@ -17,6 +17,12 @@
 #include <jailhouse/printk.h>
 #include <asm/pci.h>
 
+/*
+ * Cells own their physical local APICs, and external interrupts do not cause
+ * VM exits. The IPI sent here therefore lands in the target guest without a
+ * hypervisor round-trip, just like remapped device MSIs. Only the sender's
+ * doorbell write traps.
+ */
 void arch_ivshmem_trigger_interrupt(struct ivshmem_endpoint *ive,
 				    unsigned int vector)
 {
@@ -105,8 +105,9 @@ static void parse_widths(struct parse_context *ctx,
 	}
 }
 
-struct mmio_instruction
-x86_mmio_parse(const struct guest_paging_structures *pg_structs, bool is_write)
+static struct mmio_instruction
+mmio_decode(const struct guest_paging_structures *pg_structs, bool is_write,
+	    int *out_reg_num)
 {
 	struct parse_context ctx = { .remaining = X86_MAX_INST_LEN,
 				     .count = 1 };
@@ -182,6 +183,7 @@ restart:
 	case X86_OP_MOV_AX_TO_MEM:
 		parse_widths(&ctx, &inst, true);
 		inst.out_val = guest_regs->by_index[15];
+		*out_reg_num = 15;
 		ctx.does_write = true;
 		goto final;
 	default:
@@ -278,8 +280,10 @@ restart:
 			inst.out_val = (s64)(s32)inst.out_val;
 	} else {
 		inst.inst_len += skip_len;
-		if (ctx.does_write)
+		if (ctx.does_write) {
 			inst.out_val = guest_regs->by_index[inst.in_reg_num];
+			*out_reg_num = inst.in_reg_num;
+		}
 	}
 
 final:
@@ -307,3 +311,70 @@ error:
 	inst.inst_len = 0;
 	return inst;
 }
+
+static unsigned int mmio_cpu_mode(void)
+{
+	return (vcpu_vendor_get_cs_attr() & (VCPU_CS_L | VCPU_CS_DB)) |
+		((vcpu_vendor_get_efer() & EFER_LMA) ? 1 : 0);
+}
+
+struct mmio_instruction
+x86_mmio_parse(const struct guest_paging_structures *pg_structs, bool is_write)
+{
+	struct mmio_inst_cache *cache = &this_cpu_data()->mmio_inst_cache;
+	unsigned long root_table_gphys =
+		pg_structs->root_paging ? pg_structs->root_table_gphys : 0;
+	struct mmio_inst_cache_entry *entry;
+	struct mmio_instruction inst;
+	unsigned long rip;
+	unsigned int mode, n;
+	int out_reg_num = -1;
+
+	if (!(this_cell()->config->flags & JAILHOUSE_CELL_MMIO_DECODE_CACHE))
+		return mmio_decode(pg_structs, is_write, &out_reg_num);
+
+	rip = vcpu_vendor_get_rip();
+	mode = mmio_cpu_mode();
+
+	for (n = 0; n < cache->valid; n++) {
+		entry = &cache->entries[n];
+		if (entry->rip != rip || entry->is_write != is_write ||
+		    entry->root_paging != pg_structs->root_paging ||
+		    entry->root_table_gphys != root_table_gphys ||
+		    entry->mode != mode)
+			continue;
+
+		inst = entry->inst;
+		if (entry->out_reg_num >= 0)
+			inst.out_val = this_cpu_data()->guest_regs.by_index[
+					entry->out_reg_num];
+		return inst;
+	}
+
+	inst = mmio_decode(pg_structs, is_write, &out_reg_num);
+	if (inst.inst_len == 0)
+		return inst;
+
+	entry = &cache->entries[cache->next];
+	entry->root_paging = pg_structs->root_paging;
+	entry->root_table_gphys = root_table_gphys;
+	entry->rip = rip;
+	entry->mode = mode;
+	entry->is_write = is_write;
+	entry->out_reg_num = out_reg_num;
+	entry->inst = inst;
+
+	cache->next = (cache->next + 1) % MMIO_INST_CACHE_ENTRIES;
+	if (cache->valid < MMIO_INST_CACHE_ENTRIES)
+		cache->valid++;
+
+	return inst;
+}
+
+void x86_mmio_inst_cache_flush(void)
+{
+	struct mmio_inst_cache *cache = &this_cpu_data()->mmio_inst_cache;
+
+	cache->valid = 0;
+	cache->next = 0;
+}
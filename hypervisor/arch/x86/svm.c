@@ -18,6 +18,7 @@
 #include <jailhouse/cell.h>
 #include <jailhouse/cell-config.h>
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/processor.h>
@@ -106,8 +107,18 @@ static int svm_check_features(void)
 	if ((cpuid_edx(0x8000000A, 0) & X86_FEATURE_DECODE_ASSISTS))
 		has_assists = true;
 
-	/* AVIC support */
-	/* FIXME: Jailhouse support is incomplete so far
+	/*
+	 * AVIC support
+	 *
+	 * Not enabled: Cells own their physical local APIC, so interrupts
+	 * from passed-through devices, other cells and the hypervisor are
+	 * delivered to the guest without any VM exit already. AVIC would
+	 * replace the physical APIC with a virtual one, requiring to
+	 * intercept and reinject all physical interrupts and to program the
+	 * IOMMU in guest virtual APIC mode, which the AMD IOMMU driver does
+	 * not support. The only exits left on this path are ICR writes for
+	 * IPIs (and, in xAPIC mode, other APIC register writes) that must be
+	 * filtered for cell isolation anyway.
 	if (cpuid_edx(0x8000000A, 0) & X86_FEATURE_AVIC)
 		has_avic = true; */
 
@@ -218,8 +229,6 @@ static void vmcb_setup(struct per_cpu *cpu_data)
 	/* No more than one guest owns the CPU */
 	vmcb->guest_asid = 1;
 
-	/* TODO: Setup AVIC */
-
 	/* Explicitly mark all of the state as new */
 	vmcb->clean_bits = 0;
 
@@ -778,6 +787,7 @@ static bool svm_handle_msr_write(struct per_cpu *cpu_data)
 
 	if (cpu_data->guest_regs.rcx == MSR_EFER) {
 		cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
 		/* Never let a guest to disable SVME; see APMv2, Sect. 3.1.7 */
 		efer = get_wrmsr_value(&cpu_data->guest_regs) | EFER_SVME;
 		/* Flush TLB on LME/NXE change: See APMv2, Sect. 15.16 */
@@ -793,8 +803,8 @@ static bool svm_handle_msr_write(struct per_cpu *cpu_data)
 }
 
 /*
- * TODO: This handles unaccelerated (non-AVIC) access. AVIC should
- * be treated separately in svm_handle_avic_access().
+ * Handles unaccelerated (non-AVIC) xAPIC writes. See svm_check_features()
+ * for why AVIC is not used.
  */
 static bool svm_handle_apic_access(struct vmcb *vmcb)
 {
@@ -866,7 +876,7 @@ unsigned long vcpu_vendor_get_guest_cr4(void)
 	return this_cpu_data()->vmcb.cr4;
 }
 
-void vcpu_handle_exit(struct per_cpu *cpu_data)
+void vcpu_vendor_handle_exit(struct per_cpu *cpu_data)
 {
 	struct public_per_cpu *cpu_public = &cpu_data->public;
 	struct vmcb *vmcb = &cpu_data->vmcb;
@@ -891,6 +901,7 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		break;
 	case VMEXIT_NMI:
 		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT);
 		/* Temporarily enable GIF to consume pending NMI */
 		asm volatile("stgi; clgi" : : : "memory");
 		x86_check_events();
@@ -900,6 +911,7 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		goto vmentry;
 	case VMEXIT_CR0_SEL_WRITE:
 		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_CR]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_CR);
 		if (svm_handle_cr(cpu_data))
 			goto vmentry;
 		break;
@@ -920,23 +932,27 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		     vmcb->exitinfo2 < XAPIC_BASE + PAGE_SIZE) {
 			/* APIC access in non-AVIC mode */
 			cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_XAPIC]++;
+			latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_XAPIC);
 			if (svm_handle_apic_access(vmcb))
 				goto vmentry;
 		} else {
 			/* General MMIO (IOAPIC, PCI etc) */
 			cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_MMIO]++;
+			latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MMIO);
 			if (vcpu_handle_mmio_access())
 				goto vmentry;
 		}
 		break;
 	case VMEXIT_IOIO:
 		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_PIO]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_PIO);
 		if (vcpu_handle_io_access())
 			goto vmentry;
 		break;
 	case VMEXIT_EXCEPTION_DB:
 	case VMEXIT_EXCEPTION_AC:
 		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_EXCEPTION]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_EXCEPTION);
 		/* Reinject exception, including error code if needed. */
 		vmcb->eventinj = (vmcb->exitcode - VMEXIT_EXCEPTION_DE) |
 			SVM_EVENTINJ_EXCEPTION | SVM_EVENTINJ_VALID;
@@ -946,7 +962,6 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		}
 		x86_check_events();
 		goto vmentry;
-	/* TODO: Handle VMEXIT_AVIC_NOACCEL and VMEXIT_AVIC_INCOMPLETE_IPI */
 	default:
 		panic_printk("FATAL: Unexpected #VMEXIT, exitcode %llx, "
 			     "exitinfo1 0x%016llx exitinfo2 0x%016llx\n",
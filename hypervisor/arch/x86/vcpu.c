@@ -13,6 +13,7 @@
  */
 
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/mmio.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/pci.h>
@@ -174,6 +175,13 @@ void vcpu_cell_exit(struct cell *cell)
 	vcpu_vendor_cell_exit(cell);
 }
 
+void vcpu_handle_exit(struct per_cpu *cpu_data)
+{
+	latency_exit_begin();
+	vcpu_vendor_handle_exit(cpu_data);
+	latency_exit_end();
+}
+
 void vcpu_handle_hypercall(void)
 {
 	union registers *guest_regs = &this_cpu_data()->guest_regs;
@@ -304,10 +312,12 @@ bool vcpu_handle_msr_read(void)
 		break;
 	case MSR_IA32_PAT:
 		cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
 		set_rdmsr_value(&cpu_data->guest_regs, cpu_data->pat);
 		break;
 	case MSR_IA32_MTRR_DEF_TYPE:
 		cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
 		set_rdmsr_value(&cpu_data->guest_regs,
 				cpu_data->mtrr_def_type);
 		break;
@@ -334,6 +344,7 @@ bool vcpu_handle_msr_write(void)
 		break;
 	case MSR_IA32_PAT:
 		cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
 		val = get_wrmsr_value(&cpu_data->guest_regs);
 		for (bit_pos = 0; bit_pos < 64; bit_pos += 8) {
 			pa = (val >> bit_pos) & 0xff;
@@ -349,6 +360,7 @@ bool vcpu_handle_msr_write(void)
 		break;
 	case MSR_IA32_MTRR_DEF_TYPE:
 		cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
 		/*
 		 * This only emulates the difference between MTRRs enabled
 		 * and disabled. When disabled, we turn off all caching by
@@ -378,6 +390,7 @@ void vcpu_handle_cpuid(void)
 	u32 function = guest_regs->rax;
 
 	this_cpu_data()->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_CPUID]++;
+	latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_CPUID);
 
 	switch (function) {
 	case JAILHOUSE_CPUID_SIGNATURE:
@@ -428,6 +441,8 @@ void vcpu_reset(unsigned int sipi_vector)
 
 	memset(&cpu_data->guest_regs, 0, sizeof(cpu_data->guest_regs));
 
+	x86_mmio_inst_cache_flush();
+
 	if (sipi_vector == APIC_BSP_PSEUDO_SIPI) {
 		cpu_data->pat = PAT_RESET_VALUE;
 		cpu_data->mtrr_def_type &= ~MTRR_ENABLE;
@@ -18,6 +18,7 @@
 #include <jailhouse/printk.h>
 #include <jailhouse/string.h>
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/hypercall.h>
 #include <asm/apic.h>
 #include <asm/control.h>
@@ -335,6 +336,16 @@ unsigned long arch_paging_gphys2phys(unsigned long gphys, unsigned long flags)
 				flags);
 }
 
+/*
+ * If VT-d shares the EPT of a cell, page table updates have to be visible to
+ * non-coherent DMAR units.
+ */
+static unsigned long ept_paging_flags(struct cell *cell)
+{
+	return (cell->config->flags & JAILHOUSE_CELL_SHARED_DMA_PT) ?
+		PAGING_COHERENT : PAGING_NON_COHERENT;
+}
+
 int vcpu_vendor_cell_init(struct cell *cell)
 {
 	/* build root EPT of cell */
@@ -342,13 +353,22 @@ int vcpu_vendor_cell_init(struct cell *cell)
 	cell->arch.vmx.ept_structs.root_table =
 		(page_table_t)cell->arch.root_table_page;
 
+	if (cell->config->flags & JAILHOUSE_CELL_XAPIC_DIRECT_READ)
+		/*
+		 * Map xAPIC as is, using the UC memory type; reads are passed,
+		 * writes are trapped.
+		 */
+		return paging_create(&cell->arch.vmx.ept_structs, XAPIC_BASE,
+				     PAGE_SIZE, XAPIC_BASE, EPT_FLAG_READ,
+				     ept_paging_flags(cell) | PAGING_NO_HUGE);
+
 	/* Map the special APIC access page into the guest's physical address
 	 * space at the default address (XAPIC_BASE) */
 	return paging_create(&cell->arch.vmx.ept_structs,
 			     paging_hvirt2phys(apic_access_page),
 			     PAGE_SIZE, XAPIC_BASE,
 			     EPT_FLAG_READ | EPT_FLAG_WRITE | EPT_FLAG_WB_TYPE,
-			     PAGING_NON_COHERENT | PAGING_NO_HUGE);
+			     ept_paging_flags(cell) | PAGING_NO_HUGE);
 }
 
 int vcpu_map_memory_region(struct cell *cell,
@@ -356,7 +376,7 @@ int vcpu_map_memory_region(struct cell *cell,
 {
 	u64 phys_start = mem->phys_start;
 	unsigned long access_flags = EPT_FLAG_WB_TYPE;
-	unsigned long paging_flags = PAGING_NON_COHERENT | PAGING_HUGE;
+	unsigned long paging_flags = ept_paging_flags(cell) | PAGING_HUGE;
 
 	if (mem->flags & JAILHOUSE_MEM_READ)
 		access_flags |= EPT_FLAG_READ;
@@ -377,13 +397,13 @@ int vcpu_unmap_memory_region(struct cell *cell,
 			     const struct jailhouse_memory *mem)
 {
 	return paging_destroy(&cell->arch.vmx.ept_structs, mem->virt_start,
-			      mem->size, PAGING_NON_COHERENT);
+			      mem->size, ept_paging_flags(cell));
 }
 
 void vcpu_vendor_cell_exit(struct cell *cell)
 {
 	paging_destroy(&cell->arch.vmx.ept_structs, XAPIC_BASE, PAGE_SIZE,
-		       PAGING_NON_COHERENT);
+		       ept_paging_flags(cell));
 }
 
 void vcpu_tlb_flush(void)
@@ -928,9 +948,11 @@ static void vmx_handle_exception_nmi(void)
 
 	if ((intr_info & INTR_INFO_INTR_TYPE_MASK) == INTR_TYPE_NMI_INTR) {
 		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT);
 		asm volatile("int %0" : : "i" (NMI_VECTOR));
 	} else {
 		cpu_public->stats[JAILHOUSE_CPU_STAT_VMEXITS_EXCEPTION]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_EXCEPTION);
 		/*
 		 * Reinject the event straight away. We only intercept #DB and
 		 * #AC to prevent that malicious guests can trigger infinite
@@ -1039,10 +1061,26 @@ void vcpu_vendor_set_guest_pat(unsigned long val)
 	vmcs_write64(GUEST_IA32_PAT, val);
 }
 
-static bool vmx_handle_apic_access(void)
+static bool vmx_emulate_apic_access(unsigned int offset, bool is_write)
 {
 	struct guest_paging_structures pg_structs;
-	unsigned int inst_len, offset;
+	unsigned int inst_len;
+
+	if (offset & 0x00f)
+		return false;
+
+	vcpu_get_guest_paging_structs(&pg_structs);
+
+	inst_len = apic_mmio_access(&pg_structs, offset >> 4, is_write);
+	if (!inst_len)
+		return false;
+
+	vcpu_skip_emulated_instruction(inst_len);
+	return true;
+}
+
+static bool vmx_handle_apic_access(void)
+{
 	u64 qualification;
 	bool is_write;
 
@@ -1052,24 +1090,27 @@ static bool vmx_handle_apic_access(void)
 	case APIC_ACCESS_TYPE_LINEAR_READ:
 	case APIC_ACCESS_TYPE_LINEAR_WRITE:
 		is_write = !!(qualification & APIC_ACCESS_TYPE_LINEAR_WRITE);
-		offset = qualification & APIC_ACCESS_OFFSET_MASK;
-		if (offset & 0x00f)
-			break;
-
-		vcpu_get_guest_paging_structs(&pg_structs);
-
-		inst_len = apic_mmio_access(&pg_structs, offset >> 4, is_write);
-		if (!inst_len)
-			break;
-
-		vcpu_skip_emulated_instruction(inst_len);
-		return true;
+		if (vmx_emulate_apic_access(qualification &
+					    APIC_ACCESS_OFFSET_MASK, is_write))
+			return true;
 	}
 	panic_printk("FATAL: Unhandled APIC access, "
 		     "qualification %llx\n", qualification);
 	return false;
 }
 
+/* Write to the directly mapped xAPIC, see JAILHOUSE_CELL_XAPIC_DIRECT_READ */
+static bool vmx_handle_direct_xapic_write(unsigned long gphys)
+{
+	unsigned int offset = gphys - XAPIC_BASE;
+
+	if (vmx_emulate_apic_access(offset, true))
+		return true;
+
+	panic_printk("FATAL: Unhandled APIC write, offset %x\n", offset);
+	return false;
+}
+
 static bool vmx_handle_xsetbv(void)
 {
 	union registers *guest_regs = &this_cpu_data()->guest_regs;
@@ -1146,10 +1187,11 @@ void vcpu_vendor_get_mmio_intercept(struct vcpu_mmio_intercept *mmio)
 	mmio->is_write = !!(exitq & 0x2);
 }
 
-void vcpu_handle_exit(struct per_cpu *cpu_data)
+void vcpu_vendor_handle_exit(struct per_cpu *cpu_data)
 {
 	u32 reason = vmcs_read32(VM_EXIT_REASON);
 	u32 *stats = cpu_data->public.stats;
+	unsigned long gphys;
 
 	stats[JAILHOUSE_CPU_STAT_VMEXITS_TOTAL]++;
 
@@ -1159,6 +1201,7 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		return;
 	case EXIT_REASON_PREEMPTION_TIMER:
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT);
 		vmx_check_events();
 		return;
 	case EXIT_REASON_CPUID:
@@ -1169,11 +1212,13 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		return;
 	case EXIT_REASON_CR_ACCESS:
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_CR]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_CR);
 		if (vmx_handle_cr())
 			return;
 		break;
 	case EXIT_REASON_MSR_READ:
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
 		if (vcpu_handle_msr_read())
 			return;
 		break;
@@ -1181,6 +1226,7 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		if (cpu_data->guest_regs.rcx == MSR_IA32_PERF_GLOBAL_CTRL) {
 			/* ignore writes */
 			stats[JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER]++;
+			latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER);
 			vcpu_skip_emulated_instruction(X86_INST_LEN_WRMSR);
 			return;
 		} else if (vcpu_handle_msr_write())
@@ -1188,21 +1234,33 @@ void vcpu_handle_exit(struct per_cpu *cpu_data)
 		break;
 	case EXIT_REASON_APIC_ACCESS:
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_XAPIC]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_XAPIC);
 		if (vmx_handle_apic_access())
 			return;
 		break;
 	case EXIT_REASON_XSETBV:
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_XSETBV]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_XSETBV);
 		if (vmx_handle_xsetbv())
 			return;
 		break;
 	case EXIT_REASON_IO_INSTRUCTION:
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_PIO]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_PIO);
 		if (vcpu_handle_io_access())
 			return;
 		break;
 	case EXIT_REASON_EPT_VIOLATION:
+		gphys = vmcs_read64(GUEST_PHYSICAL_ADDRESS);
+		if (gphys >= XAPIC_BASE && gphys < XAPIC_BASE + PAGE_SIZE) {
+			stats[JAILHOUSE_CPU_STAT_VMEXITS_XAPIC]++;
+			latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_XAPIC);
+			if (vmx_handle_direct_xapic_write(gphys))
+				return;
+			break;
+		}
 		stats[JAILHOUSE_CPU_STAT_VMEXITS_MMIO]++;
+		latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_MMIO);
 		if (vcpu_handle_mmio_access())
 			return;
 		break;
@@ -24,6 +24,7 @@
 #include <asm/iommu.h>
 #include <asm/ioapic.h>
 #include <asm/spinlock.h>
+#include <asm/vmx.h>
 
 #define VTD_INTERRUPT_LIMIT()	\
 	system_config->platform_info.x86.vtd_interrupt_limit
@@ -57,7 +58,10 @@ struct vtd_entry {
 # define VTD_CAP_SLLPS2M		(1UL << 34)
 # define VTD_CAP_SLLPS1G		(1UL << 35)
 # define VTD_CAP_FRO_MASK		BIT_MASK(33, 24)
+# define VTD_CAP_PSI			(1UL << 39)
 # define VTD_CAP_NFR_MASK		BIT_MASK(47, 40)
+# define VTD_CAP_MAMV_MASK		BIT_MASK(53, 48)
+# define VTD_CAP_MAMV_SHIFT		48
 #define VTD_ECAP_REG			0x10
 # define VTD_ECAP_QI			(1UL << 1)
 # define VTD_ECAP_IR			(1UL << 3)
@@ -106,9 +110,12 @@ struct vtd_entry {
 #define VTD_REQ_INV_IOTLB		0x02
 # define VTD_INV_IOTLB_GLOBAL		(1UL << 4)
 # define VTD_INV_IOTLB_DOMAIN		(2UL << 4)
+# define VTD_INV_IOTLB_PAGE		(3UL << 4)
 # define VTD_INV_IOTLB_DW		(1UL << 6)
 # define VTD_INV_IOTLB_DR		(1UL << 7)
 # define VTD_INV_IOTLB_DOMAIN_SHIFT	16
+# define VTD_INV_IOTLB_AM_MASK		BIT_MASK(5, 0)
+# define VTD_INV_IOTLB_ADDR_MASK	BIT_MASK(63, 12)
 
 #define VTD_REQ_INV_INT			0x04
 # define VTD_INV_INT_GLOBAL		(0UL << 4)
@@ -124,6 +131,14 @@ struct vtd_entry {
 #define  VTD_INV_WAIT_FN		(1UL << 6)
 #define  VTD_INV_WAIT_SDATA_SHIFT	32
 
+#define VTD_INV_QUEUE_ENTRIES		(PAGE_SIZE / sizeof(struct vtd_entry))
+
+/*
+ * Maximum number of page-selective IOTLB invalidations per domain and config
+ * commit. Beyond this, a domain-selective invalidation is cheaper.
+ */
+#define VTD_MAX_PSI_REQUESTS		32
+
 #define VTD_FRCD_LO_REG			0x0
 #define  VTD_FRCD_LO_FI_MASK		BIT_MASK(63, 12)
 #define VTD_FRCD_HI_REG			0x8
@@ -200,7 +215,13 @@ static void *unit_inv_queue;
 static unsigned int dmar_units;
 static unsigned int dmar_pt_levels;
 static unsigned int dmar_num_did = ~0U;
+static bool dmar_psi_supported;
+static bool dmar_ept_compatible;
+static unsigned int dmar_psi_max_am = ~0U;
 static spinlock_t inv_queue_lock;
+static unsigned int inv_queue_tail[JAILHOUSE_MAX_IOMMU_UNITS];
+static unsigned int inv_queue_count[JAILHOUSE_MAX_IOMMU_UNITS];
+static unsigned long inv_queue_pending;
 static struct vtd_emulation root_cell_units[JAILHOUSE_MAX_IOMMU_UNITS];
 static bool dmar_units_initialized;
 
@@ -217,21 +238,28 @@ static unsigned int inv_queue_write(void *inv_queue, unsigned int index,
 	entry[index] = content;
 	arch_paging_flush_cpu_caches(&entry[index], sizeof(*entry));
 
-	return (index + 1) % (PAGE_SIZE / sizeof(*entry));
+	return (index + 1) % VTD_INV_QUEUE_ENTRIES;
 }
 
-static void vtd_submit_iq_request(void *reg_base, void *inv_queue,
-				  const struct vtd_entry *inv_request)
+static struct vtd_entry vtd_inv_wait(unsigned int unit_no)
 {
 	struct vtd_entry inv_wait = {
 		.lo_word = VTD_REQ_INV_WAIT | VTD_INV_WAIT_SW |
 			VTD_INV_WAIT_FN | (1UL << VTD_INV_WAIT_SDATA_SHIFT),
 		.hi_word = paging_hvirt2phys(
-				&per_cpu(this_cpu_id())->vtd_iq_completed),
+			&per_cpu(this_cpu_id())->vtd_iq_completed[unit_no]),
 	};
-	unsigned int index;
 
-	this_cpu_data()->vtd_iq_completed = 0;
+	this_cpu_data()->vtd_iq_completed[unit_no] = 0;
+
+	return inv_wait;
+}
+
+static void vtd_submit_iq_request(unsigned int unit_no, void *reg_base,
+				  void *inv_queue,
+				  const struct vtd_entry *inv_request)
+{
+	unsigned int index;
 
 	spin_lock(&inv_queue_lock);
 
@@ -239,17 +267,90 @@ static void vtd_submit_iq_request(void *reg_base, void *inv_queue,
 
 	if (inv_request)
 		index = inv_queue_write(inv_queue, index, *inv_request);
-	index = inv_queue_write(inv_queue, index, inv_wait);
+	index = inv_queue_write(inv_queue, index, vtd_inv_wait(unit_no));
 
 	mmio_write64_field(reg_base + VTD_IQT_REG, VTD_IQT_QT_MASK, index);
 
-	while (!this_cpu_data()->vtd_iq_completed)
+	while (!this_cpu_data()->vtd_iq_completed[unit_no])
 		cpu_relax();
 
 	spin_unlock(&inv_queue_lock);
 }
 
-static void vtd_flush_domain_caches(unsigned int did)
+/*
+ * Invalidation requests for multiple DMAR units are batched: After
+ * vtd_iq_batch_begin, requests are only written to the units' queues by
+ * vtd_iq_batch_queue. vtd_iq_batch_commit then appends a single wait
+ * descriptor per unit, kicks off all units and waits for their completion in
+ * parallel.
+ */
+static void vtd_iq_batch_begin(void)
+{
+	spin_lock(&inv_queue_lock);
+}
+
+static void vtd_iq_batch_flush(void)
+{
+	unsigned int unit_no;
+
+	for (unit_no = 0; unit_no < dmar_units; unit_no++) {
+		if (!test_bit(unit_no, &inv_queue_pending))
+			continue;
+		inv_queue_tail[unit_no] =
+			inv_queue_write(unit_inv_queue + unit_no * PAGE_SIZE,
+					inv_queue_tail[unit_no],
+					vtd_inv_wait(unit_no));
+		mmio_write64_field(dmar_reg_base + unit_no * DMAR_MMIO_SIZE +
+				   VTD_IQT_REG, VTD_IQT_QT_MASK,
+				   inv_queue_tail[unit_no]);
+	}
+
+	for (unit_no = 0; unit_no < dmar_units; unit_no++)
+		while (test_bit(unit_no, &inv_queue_pending) &&
+		       !this_cpu_data()->vtd_iq_completed[unit_no])
+			cpu_relax();
+
+	inv_queue_pending = 0;
+}
+
+static void vtd_iq_batch_queue(unsigned int unit_no,
+			       const struct vtd_entry *inv_request)
+{
+	void *reg_base = dmar_reg_base + unit_no * DMAR_MMIO_SIZE;
+
+	/* keep room for the wait descriptor, flush early if needed */
+	if (test_bit(unit_no, &inv_queue_pending) &&
+	    inv_queue_count[unit_no] >= VTD_INV_QUEUE_ENTRIES - 2)
+		vtd_iq_batch_flush();
+
+	if (!test_bit(unit_no, &inv_queue_pending)) {
+		inv_queue_tail[unit_no] = mmio_read64_field(
+				reg_base + VTD_IQT_REG, VTD_IQT_QT_MASK);
+		inv_queue_count[unit_no] = 0;
+		set_bit(unit_no, &inv_queue_pending);
+	}
+
+	inv_queue_tail[unit_no] =
+		inv_queue_write(unit_inv_queue + unit_no * PAGE_SIZE,
+				inv_queue_tail[unit_no], *inv_request);
+	inv_queue_count[unit_no]++;
+}
+
+static void vtd_iq_batch_queue_all(const struct vtd_entry *inv_request)
+{
+	unsigned int n;
+
+	for (n = 0; n < dmar_units; n++)
+		vtd_iq_batch_queue(n, inv_request);
+}
+
+static void vtd_iq_batch_commit(void)
+{
+	vtd_iq_batch_flush();
+	spin_unlock(&inv_queue_lock);
+}
+
+static void vtd_queue_domain_flush(unsigned int did)
 {
 	const struct vtd_entry inv_context = {
 		.lo_word = VTD_REQ_INV_CONTEXT | VTD_INV_CONTEXT_DOMAIN |
@@ -260,16 +361,60 @@ static void vtd_flush_domain_caches(unsigned int did)
 			VTD_INV_IOTLB_DW | VTD_INV_IOTLB_DR |
 			(did << VTD_INV_IOTLB_DOMAIN_SHIFT),
 	};
-	void *inv_queue = unit_inv_queue;
-	void *reg_base = dmar_reg_base;
-	unsigned int n;
 
-	for (n = 0; n < dmar_units; n++) {
-		vtd_submit_iq_request(reg_base, inv_queue, &inv_context);
-		vtd_submit_iq_request(reg_base, inv_queue, &inv_iotlb);
-		reg_base += DMAR_MMIO_SIZE;
-		inv_queue += PAGE_SIZE;
+	vtd_iq_batch_queue_all(&inv_context);
+	vtd_iq_batch_queue_all(&inv_iotlb);
+}
+
+static void vtd_queue_psi_flush(struct cell *cell)
+{
+	struct vtd_entry inv_iotlb = {
+		.lo_word = VTD_REQ_INV_IOTLB | VTD_INV_IOTLB_PAGE |
+			VTD_INV_IOTLB_DW | VTD_INV_IOTLB_DR |
+			(cell->config->id << VTD_INV_IOTLB_DOMAIN_SHIFT),
+	};
+	unsigned long addr, end;
+	unsigned int n, am;
+
+	for (n = 0; n < cell->arch.iommu_inv.num_ranges; n++) {
+		addr = cell->arch.iommu_inv.ranges[n].start;
+		end = addr + cell->arch.iommu_inv.ranges[n].size;
+		while (addr < end) {
+			am = iommu_inv_order(addr, end, dmar_psi_max_am);
+			inv_iotlb.hi_word = (addr & VTD_INV_IOTLB_ADDR_MASK) |
+				am;
+			vtd_iq_batch_queue_all(&inv_iotlb);
+			addr += PAGE_SIZE << am;
+		}
+	}
+}
+
+/*
+ * Invalidate the cached translations of a cell that changed since the last
+ * commit. Only the modified ranges are invalidated if possible.
+ */
+static void vtd_queue_cell_flush(struct cell *cell)
+{
+	u32 *stats = this_cpu_public()->stats;
+	unsigned int requests = 0;
+
+	if (!cell->arch.iommu_inv.domain &&
+	    cell->arch.iommu_inv.num_ranges == 0)
+		return;
+
+	if (!cell->arch.iommu_inv.domain && dmar_psi_supported)
+		requests = iommu_inv_requests(cell, dmar_psi_max_am);
+
+	if (requests > 0 && requests <= VTD_MAX_PSI_REQUESTS) {
+		vtd_queue_psi_flush(cell);
+		stats[JAILHOUSE_CPU_STAT_IOMMU_INV_PAGE] += requests;
+	} else {
+		vtd_queue_domain_flush(cell->config->id);
+		stats[JAILHOUSE_CPU_STAT_IOMMU_INV_DOMAIN]++;
 	}
+
+	cell->arch.iommu_inv.domain = false;
+	cell->arch.iommu_inv.num_ranges = 0;
 }
 
 static void vtd_update_gcmd_reg(void *reg_base, u32 mask, unsigned int set)
@@ -547,13 +692,6 @@ static void vtd_init_unit(void *reg_base, void *inv_queue)
 	mmio_write64(reg_base + VTD_IQT_REG, 0);
 	mmio_write64(reg_base + VTD_IQA_REG, paging_hvirt2phys(inv_queue));
 	vtd_update_gcmd_reg(reg_base, VTD_GCMD_QIE, 1);
-
-	vtd_submit_iq_request(reg_base, inv_queue, &inv_global_context);
-	vtd_submit_iq_request(reg_base, inv_queue, &inv_global_iotlb);
-	vtd_submit_iq_request(reg_base, inv_queue, &inv_global_int);
-
-	vtd_update_gcmd_reg(reg_base, VTD_GCMD_TE, 1);
-	vtd_update_gcmd_reg(reg_base, VTD_GCMD_IRE, 1);
 }
 
 static void vtd_update_irte(unsigned int index, union vtd_irte content)
@@ -563,9 +701,6 @@ static void vtd_update_irte(unsigned int index, union vtd_irte content)
 			((u64)index << VTD_INV_INT_IIDX_SHIFT),
 	};
 	union vtd_irte *irte = &int_remap_table[index];
-	void *inv_queue = unit_inv_queue;
-	void *reg_base = dmar_reg_base;
-	unsigned int n;
 
 	if (content.field.p) {
 		/*
@@ -586,11 +721,9 @@ static void vtd_update_irte(unsigned int index, union vtd_irte content)
 	}
 	arch_paging_flush_cpu_caches(irte, sizeof(*irte));
 
-	for (n = 0; n < dmar_units; n++) {
-		vtd_submit_iq_request(reg_base, inv_queue, &inv_int);
-		reg_base += DMAR_MMIO_SIZE;
-		inv_queue += PAGE_SIZE;
-	}
+	vtd_iq_batch_begin();
+	vtd_iq_batch_queue_all(&inv_int);
+	vtd_iq_batch_commit();
 }
 
 static int vtd_find_int_remap_region(u16 device_id)
@@ -681,6 +814,8 @@ int iommu_add_pci_device(struct cell *cell, struct pci_device *device)
 		(cell->config->id << VTD_CTX_DID_SHIFT);
 	arch_paging_flush_cpu_caches(context_entry, sizeof(*context_entry));
 
+	cell->arch.iommu_inv.domain = true;
+
 	return 0;
 
 error_nomem:
@@ -705,6 +840,9 @@ void iommu_remove_pci_device(struct pci_device *device)
 	context_entry->lo_word &= ~VTD_CTX_PRESENT;
 	arch_paging_flush_cpu_caches(&context_entry->lo_word, sizeof(u64));
 
+	if (device->cell)
+		device->cell->arch.iommu_inv.domain = true;
+
 	for (n = 0; n < 256; n++)
 		if (context_entry_table[n].lo_word & VTD_CTX_PRESENT)
 			return;
@@ -728,9 +866,25 @@ static int vtd_cell_init(struct cell *cell)
 		return trace_error(-ERANGE);
 
 	cell->arch.vtd.pg_structs.root_paging = vtd_paging;
-	cell->arch.vtd.pg_structs.root_table = page_alloc(&mem_pool, 1);
-	if (!cell->arch.vtd.pg_structs.root_table)
-		return -ENOMEM;
+
+	if (cell->config->flags & JAILHOUSE_CELL_SHARED_DMA_PT) {
+		if (dmar_ept_compatible)
+			cell->arch.vtd.shared_pt = true;
+		else
+			printk("WARNING: Cannot share EPT with VT-d, using "
+			       "separate page tables for cell \"%s\"\n",
+			       cell->config->name);
+	}
+
+	if (cell->arch.vtd.shared_pt) {
+		cell->arch.vtd.pg_structs.root_table =
+			(page_table_t)cell->arch.root_table_page;
+	} else {
+		cell->arch.vtd.pg_structs.root_table =
+			page_alloc(&mem_pool, 1);
+		if (!cell->arch.vtd.pg_structs.root_table)
+			return -ENOMEM;
+	}
 
 	/* reserve regions for IRQ chips (if not done already) */
 	for (n = 0; n < cell->config->num_irqchips; n++, irqchip++) {
@@ -752,6 +906,13 @@ int iommu_map_memory_region(struct cell *cell,
 {
 	unsigned long access_flags = 0;
 	unsigned long paging_flags = PAGING_COHERENT | PAGING_HUGE;
+	int err;
+
+	if (cell->arch.vtd.shared_pt) {
+		/* vcpu_map_memory_region already did the actual work. */
+		iommu_record_inv_range(cell, mem->virt_start, mem->size);
+		return 0;
+	}
 
 	if (!(mem->flags & JAILHOUSE_MEM_DMA))
 		return 0;
@@ -766,19 +927,34 @@ int iommu_map_memory_region(struct cell *cell,
 	if (mem->flags & JAILHOUSE_MEM_NO_HUGEPAGES)
 		paging_flags &= ~PAGING_HUGE;
 
-	return paging_create(&cell->arch.vtd.pg_structs, mem->phys_start,
-			     mem->size, mem->virt_start, access_flags,
-			     paging_flags);
+	err = paging_create(&cell->arch.vtd.pg_structs, mem->phys_start,
+			    mem->size, mem->virt_start, access_flags,
+			    paging_flags);
+	/* mappings may have been modified partially, so record always */
+	iommu_record_inv_range(cell, mem->virt_start, mem->size);
+
+	return err;
 }
 
 int iommu_unmap_memory_region(struct cell *cell,
 			      const struct jailhouse_memory *mem)
 {
+	int err;
+
+	if (cell->arch.vtd.shared_pt) {
+		/* vcpu_unmap_memory_region will do the actual work. */
+		iommu_record_inv_range(cell, mem->virt_start, mem->size);
+		return 0;
+	}
+
 	if (!(mem->flags & JAILHOUSE_MEM_DMA))
 		return 0;
 
-	return paging_destroy(&cell->arch.vtd.pg_structs, mem->virt_start,
-			      mem->size, PAGING_COHERENT);
+	err = paging_destroy(&cell->arch.vtd.pg_structs, mem->virt_start,
+			     mem->size, PAGING_COHERENT);
+	iommu_record_inv_range(cell, mem->virt_start, mem->size);
+
+	return err;
 }
 
 struct apic_irq_message
@@ -877,7 +1053,8 @@ update_irte:
 
 static void vtd_cell_exit(struct cell *cell)
 {
-	page_free(&mem_pool, cell->arch.vtd.pg_structs.root_table, 1);
+	if (!cell->arch.vtd.shared_pt)
+		page_free(&mem_pool, cell->arch.vtd.pg_structs.root_table, 1);
 
 	/*
 	 * Note that reservation regions of IOAPICs won't be released because
@@ -900,11 +1077,28 @@ void iommu_config_commit(struct cell *cell_added_removed)
 			reg_base += DMAR_MMIO_SIZE;
 			inv_queue += PAGE_SIZE;
 		}
+
+		vtd_iq_batch_begin();
+		vtd_iq_batch_queue_all(&inv_global_context);
+		vtd_iq_batch_queue_all(&inv_global_iotlb);
+		vtd_iq_batch_queue_all(&inv_global_int);
+		vtd_iq_batch_commit();
+
+		for (n = 0, reg_base = dmar_reg_base; n < dmar_units;
+		     n++, reg_base += DMAR_MMIO_SIZE) {
+			vtd_update_gcmd_reg(reg_base, VTD_GCMD_TE, 1);
+			vtd_update_gcmd_reg(reg_base, VTD_GCMD_IRE, 1);
+		}
 		dmar_units_initialized = true;
+
+		root_cell.arch.iommu_inv.domain = false;
+		root_cell.arch.iommu_inv.num_ranges = 0;
 	} else {
+		vtd_iq_batch_begin();
 		if (cell_added_removed)
-			vtd_flush_domain_caches(cell_added_removed->config->id);
-		vtd_flush_domain_caches(root_cell.config->id);
+			vtd_queue_cell_flush(cell_added_removed);
+		vtd_queue_cell_flush(&root_cell);
+		vtd_iq_batch_commit();
 	}
 }
 
@@ -918,7 +1112,7 @@ static void vtd_restore_ir(unsigned int unit_no, void *reg_base)
 
 	mmio_write64(reg_base + VTD_IRTA_REG, unit->irta);
 	vtd_update_gcmd_reg(reg_base, VTD_GCMD_SIRTP, 1);
-	vtd_submit_iq_request(reg_base, inv_queue, &inv_global_int);
+	vtd_submit_iq_request(unit_no, reg_base, inv_queue, &inv_global_int);
 
 	vtd_update_gcmd_reg(reg_base, VTD_GCMD_QIE, 0);
 	mmio_write64(reg_base + VTD_IQT_REG, 0);
@@ -934,7 +1128,8 @@ static void vtd_restore_ir(unsigned int unit_no, void *reg_base)
 						PAGE_DEFAULT_FLAGS);
 	if (root_inv_queue)
 		while (mmio_read64(reg_base + VTD_IQH_REG) != iqh)
-			vtd_submit_iq_request(reg_base, root_inv_queue, NULL);
+			vtd_submit_iq_request(unit_no, reg_base,
+					      root_inv_queue, NULL);
 	else
 		printk("WARNING: Failed to restore invalidation queue head\n");
 
@@ -988,8 +1183,8 @@ static int vtd_init_ir_emulation(unsigned int unit_no, void *reg_base)
 
 static int vtd_init(void)
 {
-	unsigned long version, caps, ecaps, ctrls, sllps_caps = ~0UL;
-	unsigned int units, pt_levels, num_did, n;
+	unsigned long version, caps, ecaps, ctrls, ept_cap, sllps_caps = ~0UL;
+	unsigned int units, pt_levels, num_did, mamv, n;
 	struct jailhouse_iommu *unit;
 	void *reg_base;
 	int err;
@@ -1048,6 +1243,11 @@ static int vtd_init(void)
 			return trace_error(-EIO);
 		sllps_caps &= caps;
 
+		dmar_psi_supported = !!(sllps_caps & VTD_CAP_PSI);
+		mamv = (caps & VTD_CAP_MAMV_MASK) >> VTD_CAP_MAMV_SHIFT;
+		if (mamv < dmar_psi_max_am)
+			dmar_psi_max_am = mamv;
+
 		if (dmar_pt_levels > 0 && dmar_pt_levels != pt_levels)
 			return trace_error(-EIO);
 		dmar_pt_levels = pt_levels;
@@ -1090,6 +1290,16 @@ static int vtd_init(void)
 	if (!(sllps_caps & VTD_CAP_SLLPS2M))
 		vtd_paging[dmar_pt_levels - 2].page_size = 0;
 
+	/*
+	 * The second-level page table format is compatible with the EPT,
+	 * provided that the walk depth matches and the DMAR units support all
+	 * page sizes the EPT may use.
+	 */
+	ept_cap = read_msr(MSR_IA32_VMX_EPT_VPID_CAP);
+	dmar_ept_compatible = dmar_pt_levels == EPT_PAGE_DIR_LEVELS &&
+		(!(ept_cap & EPT_2M_PAGES) || (sllps_caps & VTD_CAP_SLLPS2M)) &&
+		(!(ept_cap & EPT_1G_PAGES) || (sllps_caps & VTD_CAP_SLLPS1G));
+
 	return vtd_cell_init(&root_cell);
 }
 
@@ -12,11 +12,13 @@
 
 #include <jailhouse/entry.h>
 #include <jailhouse/control.h>
+#include <jailhouse/latency.h>
 #include <jailhouse/mmio.h>
 #include <jailhouse/printk.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/processor.h>
 #include <jailhouse/string.h>
+#include <jailhouse/trace.h>
 #include <jailhouse/unit.h>
 #include <jailhouse/utils.h>
 #include <asm/control.h>
@@ -75,25 +77,29 @@ bool cpu_id_valid(unsigned long cpu_id)
 }
 
 /**
- * Suspend a remote CPU.
+ * Request suspension of a remote CPU.
  * @param cpu_id	ID of the target CPU.
  *
  * Suspension means that the target CPU is no longer executing cell code or
  * arbitrary hypervisor code. It may actively busy-wait in the hypervisor
  * context, so the suspension time should be kept short.
  *
- * The function waits for the target CPU to enter suspended state.
+ * The function only signals the target CPU, it does not wait for it to enter
+ * suspended state. This allows to request suspension of multiple CPUs before
+ * waiting for all of them via wait_cpu_suspended(), so that the signaling
+ * round-trips overlap.
  *
  * This service can be used to synchronize with other CPUs before performing
  * management tasks.
  *
  * @note This function must not be invoked for the caller's CPU.
  *
+ * @see wait_cpu_suspended
  * @see resume_cpu
  * @see arch_reset_cpu
  * @see arch_park_cpu
  */
-static void suspend_cpu(unsigned int cpu_id)
+static void request_cpu_suspend(unsigned int cpu_id)
 {
 	struct public_per_cpu *target_data = public_per_cpu(cpu_id);
 	bool target_suspended;
@@ -109,18 +115,27 @@ static void suspend_cpu(unsigned int cpu_id)
 	 */
 	spin_unlock(&target_data->control_lock);
 
-	if (!target_suspended) {
-		/*
-		 * Send a maintenance signal to the target CPU.
-		 * Then, wait for the target CPU to enter the suspended state.
-		 * The target CPU, in turn, will leave the guest and handle the
-		 * request in the event loop.
-		 */
+	/*
+	 * Send a maintenance signal to the target CPU. The target CPU, in
+	 * turn, will leave the guest and handle the request in the event
+	 * loop.
+	 */
+	if (!target_suspended)
 		arch_send_event(target_data);
+}
 
-		while (!target_data->cpu_suspended)
-			cpu_relax();
-	}
+/**
+ * Wait for a remote CPU to enter suspended state.
+ * @param cpu_id	ID of the target CPU.
+ *
+ * @note Suspension must have been requested via request_cpu_suspend() before.
+ */
+static void wait_cpu_suspended(unsigned int cpu_id)
+{
+	struct public_per_cpu *target_data = public_per_cpu(cpu_id);
+
+	while (!target_data->cpu_suspended)
+		cpu_relax();
 }
 
 void resume_cpu(unsigned int cpu_id)
@@ -143,8 +158,15 @@ static void cell_suspend(struct cell *cell)
 {
 	unsigned int cpu;
 
+	/*
+	 * Signal all CPUs first, then wait for them. This way, the caller
+	 * only pays for a single signaling round-trip, not one per CPU.
+	 */
+	for_each_cpu_except(cpu, cell->cpu_set, this_cpu_id())
+		request_cpu_suspend(cpu);
+
 	for_each_cpu_except(cpu, cell->cpu_set, this_cpu_id())
-		suspend_cpu(cpu);
+		wait_cpu_suspended(cpu);
 }
 
 static void cell_resume(struct cell *cell)
@@ -361,8 +383,84 @@ static int remap_to_root_cell(const struct jailhouse_memory *mem,
 	return err;
 }
 
+/*
+ * Regions handed over between a cell and the root cell are collected in a
+ * batch as long as they are physically contiguous and page-aligned. This
+ * updates the root cell's mappings of a whole run of regions with a single
+ * page table walk, using the largest possible pages. TLBs and IOTLBs are only
+ * flushed once by config_commit anyway.
+ */
+static bool root_mem_batchable(const struct jailhouse_memory *mem)
+{
+	return !((mem->phys_start | mem->virt_start | mem->size) &
+		 PAGE_OFFS_MASK);
+}
+
+static bool root_mem_batch_add(struct jailhouse_memory *batch,
+			       const struct jailhouse_memory *mem)
+{
+	if (batch->size == 0 || !root_mem_batchable(batch) ||
+	    !root_mem_batchable(mem) ||
+	    batch->phys_start + batch->size != mem->phys_start ||
+	    (batch->flags & JAILHOUSE_MEM_DMA) !=
+	    (mem->flags & JAILHOUSE_MEM_DMA))
+		return false;
+
+	batch->size += mem->size;
+	return true;
+}
+
+static void root_mem_batch_reset(struct jailhouse_memory *batch,
+				 const struct jailhouse_memory *mem)
+{
+	if (mem)
+		*batch = *mem;
+	else
+		batch->size = 0;
+}
+
+/*
+ * Queue a region for unmapping from the root cell. The pending batch is
+ * unmapped if the region cannot be merged into it, or if mem is NULL.
+ */
+static int unmap_from_root_cell_batched(struct jailhouse_memory *batch,
+					const struct jailhouse_memory *mem)
+{
+	int err = 0;
+
+	if (mem && root_mem_batch_add(batch, mem))
+		return 0;
+
+	if (batch->size > 0)
+		err = unmap_from_root_cell(batch);
+	root_mem_batch_reset(batch, mem);
+
+	return err;
+}
+
+/*
+ * Queue a region for remapping to the root cell. The pending batch is
+ * remapped if the region cannot be merged into it, or if mem is NULL.
+ */
+static int remap_to_root_cell_batched(struct jailhouse_memory *batch,
+				      const struct jailhouse_memory *mem,
+				      enum failure_mode mode)
+{
+	int err = 0;
+
+	if (mem && root_mem_batch_add(batch, mem))
+		return 0;
+
+	if (batch->size > 0)
+		err = remap_to_root_cell(batch, mode);
+	root_mem_batch_reset(batch, mem);
+
+	return err;
+}
+
 static void cell_destroy_internal(struct cell *cell)
 {
+	struct jailhouse_memory batch = { .size = 0 };
 	const struct jailhouse_memory *mem;
 	unsigned int cpu, n;
 	struct unit *unit;
@@ -377,6 +475,7 @@ static void cell_destroy_internal(struct cell *cell)
 		public_per_cpu(cpu)->failed = false;
 		memset(public_per_cpu(cpu)->stats, 0,
 		       sizeof(public_per_cpu(cpu)->stats));
+		latency_reset(public_per_cpu(cpu));
 	}
 
 	for_each_mem_region(mem, cell->config, n) {
@@ -390,8 +489,9 @@ static void cell_destroy_internal(struct cell *cell)
 
 		if (!(mem->flags & (JAILHOUSE_MEM_COMM_REGION |
 				    JAILHOUSE_MEM_ROOTSHARED)))
-			remap_to_root_cell(mem, WARN_ON_ERROR);
+			remap_to_root_cell_batched(&batch, mem, WARN_ON_ERROR);
 	}
+	remap_to_root_cell_batched(&batch, NULL, WARN_ON_ERROR);
 
 	for_each_unit_reverse(unit)
 		unit->cell_exit(cell);
@@ -407,6 +507,7 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 	unsigned long cfg_page_offs = config_address & PAGE_OFFS_MASK;
 	unsigned int cfg_pages, cell_pages, cpu, n;
 	const struct jailhouse_memory *mem;
+	struct jailhouse_memory batch = { .size = 0 };
 	struct jailhouse_cell_desc *cfg;
 	unsigned long cfg_total_size;
 	struct cell *cell, *last;
@@ -512,6 +613,7 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 		public_per_cpu(cpu)->cell = cell;
 		memset(public_per_cpu(cpu)->stats, 0,
 		       sizeof(public_per_cpu(cpu)->stats));
+		latency_reset(public_per_cpu(cpu));
 	}
 
 	/*
@@ -526,7 +628,7 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 		 */
 		if (!(mem->flags & (JAILHOUSE_MEM_COMM_REGION |
 				    JAILHOUSE_MEM_ROOTSHARED))) {
-			err = unmap_from_root_cell(mem);
+			err = unmap_from_root_cell_batched(&batch, mem);
 			if (err)
 				goto err_destroy_cell;
 		}
@@ -539,6 +641,10 @@ static int cell_create(struct per_cpu *cpu_data, unsigned long config_address)
 			goto err_destroy_cell;
 	}
 
+	err = unmap_from_root_cell_batched(&batch, NULL);
+	if (err)
+		goto err_destroy_cell;
+
 	config_commit(cell);
 
 	cell->comm_page.comm_region.cell_state = JAILHOUSE_CELL_SHUT_DOWN;
@@ -621,6 +727,7 @@ static int cell_start(struct per_cpu *cpu_data, unsigned long id)
 {
 	struct jailhouse_comm_region *comm_region;
 	const struct jailhouse_memory *mem;
+	struct jailhouse_memory batch = { .size = 0 };
 	unsigned int cpu, n;
 	struct cell *cell;
 	int err;
@@ -633,10 +740,14 @@ static int cell_start(struct per_cpu *cpu_data, unsigned long id)
 		/* unmap all loadable memory regions from the root cell */
 		for_each_mem_region(mem, cell->config, n)
 			if (mem->flags & JAILHOUSE_MEM_LOADABLE) {
-				err = unmap_from_root_cell(mem);
+				err = unmap_from_root_cell_batched(&batch,
+								   mem);
 				if (err)
 					goto out_resume;
 			}
+		err = unmap_from_root_cell_batched(&batch, NULL);
+		if (err)
+			goto out_resume;
 
 		config_commit(NULL);
 
@@ -683,6 +794,7 @@ out_resume:
 static int cell_set_loadable(struct per_cpu *cpu_data, unsigned long id)
 {
 	const struct jailhouse_memory *mem;
+	struct jailhouse_memory batch = { .size = 0 };
 	unsigned int cpu, n;
 	struct cell *cell;
 	int err;
@@ -711,10 +823,14 @@ static int cell_set_loadable(struct per_cpu *cpu_data, unsigned long id)
 	/* map all loadable memory regions into the root cell */
 	for_each_mem_region(mem, cell->config, n)
 		if (mem->flags & JAILHOUSE_MEM_LOADABLE) {
-			err = remap_to_root_cell(mem, ABORT_ON_ERROR);
+			err = remap_to_root_cell_batched(&batch, mem,
+							 ABORT_ON_ERROR);
 			if (err)
 				goto out_resume;
 		}
+	err = remap_to_root_cell_batched(&batch, NULL, ABORT_ON_ERROR);
+	if (err)
+		goto out_resume;
 
 	config_commit(NULL);
 
@@ -896,6 +1012,9 @@ static long hypervisor_get_info(struct per_cpu *cpu_data, unsigned long type)
 		return remap_pool.used_pages;
 	case JAILHOUSE_INFO_NUM_CELLS:
 		return num_cells;
+	case JAILHOUSE_INFO_TRACE_OFFSET:
+	case JAILHOUSE_INFO_TRACE_SIZE:
+		return trace_get_info(type);
 	default:
 		return -EINVAL;
 	}
@@ -923,6 +1042,9 @@ static int cpu_get_info(struct per_cpu *cpu_data, unsigned long cpu_id,
 		type - JAILHOUSE_CPU_INFO_STAT_BASE < JAILHOUSE_NUM_CPU_STATS) {
 		type -= JAILHOUSE_CPU_INFO_STAT_BASE;
 		return public_per_cpu(cpu_id)->stats[type] & BIT_MASK(30, 0);
+	} else if (type >= JAILHOUSE_CPU_INFO_LATENCY_BASE) {
+		return latency_get_info(public_per_cpu(cpu_id),
+					type - JAILHOUSE_CPU_INFO_LATENCY_BASE);
 	} else
 		return -EINVAL;
 }
@@ -942,6 +1064,7 @@ long hypercall(unsigned long code, unsigned long arg1, unsigned long arg2)
 	struct per_cpu *cpu_data = this_cpu_data();
 
 	cpu_data->public.stats[JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL]++;
+	latency_exit_reason(JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL);
 
 	switch (code) {
 	case JAILHOUSE_HC_DISABLE:
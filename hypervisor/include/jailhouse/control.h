@@ -138,7 +138,7 @@ void panic_park(void);
  *
  * @note This function must not be invoked for the caller's CPU.
  *
- * @see suspend_cpu
+ * @see request_cpu_suspend
  */
 void resume_cpu(unsigned int cpu_id);
 
@@ -152,7 +152,7 @@ void resume_cpu(unsigned int cpu_id);
  * @note This function must not be invoked for the caller's CPU or if the
  * target CPU is not in suspend state.
  *
- * @see suspend_cpu
+ * @see request_cpu_suspend
  */
 void arch_reset_cpu(unsigned int cpu_id);
 
@@ -171,7 +171,7 @@ void arch_reset_cpu(unsigned int cpu_id);
  * @note This function must not be invoked for the caller's CPU or if the
  * target CPU is not in suspend state.
  *
- * @see suspend_cpu
+ * @see request_cpu_suspend
  */
 void arch_park_cpu(unsigned int cpu_id);
 
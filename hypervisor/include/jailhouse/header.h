@@ -46,6 +46,36 @@ struct jailhouse_virt_console {
 	char content[2048];
 };
 
+/* Types of struct jailhouse_trace_event */
+#define JAILHOUSE_TRACE_EXIT	1 /* code: stat index, duration valid */
+#define JAILHOUSE_TRACE_MMIO	2 /* code: is_write, arg: address, handler */
+#define JAILHOUSE_TRACE_IRQ	3 /* code: target, arg: IRQ, sender CPU */
+
+/** Hypervisor trace event, timestamps in arch_read_timestamp() ticks. */
+struct jailhouse_trace_event {
+	unsigned long long timestamp;
+	unsigned long long arg[2];
+	unsigned int duration;
+	unsigned short type;
+	unsigned short code;
+};
+
+/**
+ * Per-CPU hypervisor trace ring, mapped read-only into the root cell.
+ * Readers copy events and then re-check head to detect overwrites.
+ */
+struct jailhouse_trace_ring {
+	/** Number of events written so far, updated after each event. */
+	volatile unsigned int head;
+	/** Number of event slots, a power of two. */
+	unsigned int size;
+	unsigned int cpu_id;
+	/** Distance to the ring of the next CPU in bytes. */
+	unsigned int stride;
+	unsigned int padding[4];
+	struct jailhouse_trace_event events[];
+};
+
 /**
  * Hypervisor description.
  * Located at the beginning of the hypervisor binary image and loaded by
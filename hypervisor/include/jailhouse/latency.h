@@ -0,0 +1,131 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_LATENCY_H
+#define _JAILHOUSE_LATENCY_H
+
+#include <jailhouse/entry.h>
+#include <jailhouse/percpu.h>
+#include <jailhouse/processor.h>
+#include <jailhouse/string.h>
+#include <jailhouse/trace.h>
+
+/**
+ * @defgroup Latency Exit Latency Accounting
+ *
+ * When CONFIG_EXIT_LATENCY_STATS is enabled, the time between a VM exit and
+ * the return to the guest is measured with the architecture's timestamp
+ * counter and sorted into log2 histograms, both over all exits and per
+ * reason. Reasons are identified by their statistics counter index
+ * (JAILHOUSE_CPU_STAT_VMEXITS_*). With CONFIG_HYPERVISOR_TRACE, each exit is
+ * additionally recorded as JAILHOUSE_TRACE_EXIT event. Without either option,
+ * all services compile to nothing.
+ *
+ * @{
+ */
+
+#if defined(CONFIG_EXIT_LATENCY_STATS) || defined(CONFIG_HYPERVISOR_TRACE)
+
+/**
+ * Start the latency measurement of a VM exit.
+ */
+static inline void latency_exit_begin(void)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+
+	cpu_data->exit_timestamp = arch_read_timestamp();
+	cpu_data->exit_reason = JAILHOUSE_CPU_STAT_VMEXITS_TOTAL;
+}
+
+/**
+ * Attribute the current VM exit to a reason.
+ * @param reason	Statistics counter index of the reason.
+ */
+static inline void latency_exit_reason(unsigned int reason)
+{
+	this_cpu_data()->exit_reason = reason;
+}
+
+/**
+ * Complete the latency measurement of a VM exit.
+ */
+static inline void latency_exit_end(void)
+{
+	struct per_cpu *cpu_data = this_cpu_data();
+	u64 ticks = arch_read_timestamp() - cpu_data->exit_timestamp;
+#ifdef CONFIG_EXIT_LATENCY_STATS
+	unsigned int bucket = ticks ? 63 - __builtin_clzll(ticks) : 0;
+	u32 (*latency)[JAILHOUSE_CPU_LATENCY_BUCKETS] =
+		cpu_data->public.exit_latency;
+
+	if (bucket >= JAILHOUSE_CPU_LATENCY_BUCKETS)
+		bucket = JAILHOUSE_CPU_LATENCY_BUCKETS - 1;
+
+	latency[JAILHOUSE_CPU_STAT_VMEXITS_TOTAL][bucket]++;
+	if (cpu_data->exit_reason != JAILHOUSE_CPU_STAT_VMEXITS_TOTAL)
+		latency[cpu_data->exit_reason][bucket]++;
+#endif
+
+	trace_event(JAILHOUSE_TRACE_EXIT, cpu_data->exit_reason, 0, 0,
+		    cpu_data->exit_timestamp,
+		    ticks > (u32)-1 ? (u32)-1 : ticks);
+}
+
+#else /* !CONFIG_EXIT_LATENCY_STATS && !CONFIG_HYPERVISOR_TRACE */
+
+static inline void latency_exit_begin(void) {}
+static inline void latency_exit_reason(unsigned int reason) {}
+static inline void latency_exit_end(void) {}
+
+#endif /* !CONFIG_EXIT_LATENCY_STATS && !CONFIG_HYPERVISOR_TRACE */
+
+#ifdef CONFIG_EXIT_LATENCY_STATS
+
+/**
+ * Clear the latency histograms of a CPU.
+ * @param cpu_public	Public data structure of the target CPU.
+ */
+static inline void latency_reset(struct public_per_cpu *cpu_public)
+{
+	memset(cpu_public->exit_latency, 0, sizeof(cpu_public->exit_latency));
+}
+
+/**
+ * Read a latency histogram bucket of a CPU.
+ * @param cpu_public	Public data structure of the target CPU.
+ * @param type		Information type, relative to
+ * 			JAILHOUSE_CPU_INFO_LATENCY_BASE.
+ *
+ * @return Bucket value or negative error code.
+ */
+static inline int latency_get_info(struct public_per_cpu *cpu_public,
+				   unsigned long type)
+{
+	if (type >= JAILHOUSE_NUM_CPU_STATS * JAILHOUSE_CPU_LATENCY_BUCKETS)
+		return -EINVAL;
+
+	return cpu_public->exit_latency[type / JAILHOUSE_CPU_LATENCY_BUCKETS]
+		[type % JAILHOUSE_CPU_LATENCY_BUCKETS] & BIT_MASK(30, 0);
+}
+
+#else /* !CONFIG_EXIT_LATENCY_STATS */
+
+static inline void latency_reset(struct public_per_cpu *cpu_public) {}
+
+static inline int latency_get_info(struct public_per_cpu *cpu_public,
+				   unsigned long type)
+{
+	return -EINVAL;
+}
+
+#endif /* !CONFIG_EXIT_LATENCY_STATS */
+
+/** @} */
+
+#endif /* !_JAILHOUSE_LATENCY_H */
@@ -174,6 +174,25 @@ struct mmio_region_handler {
 	void *arg;
 };
 
+/** Number of entries in the per-CPU MMIO dispatch cache. */
+#define MMIO_CACHE_ENTRIES	4
+
+/** Per-CPU cache of recently dispatched MMIO regions. */
+struct mmio_cache {
+	/** Cell the cached regions belong to. */
+	struct cell *cell;
+	/** MMIO generation of the cell the cached regions are valid for. */
+	unsigned long generation;
+	/** Number of valid entries. */
+	unsigned int valid;
+	/** Entry to be replaced on the next miss. */
+	unsigned int next;
+	/** Cached region locations. */
+	struct mmio_region_location locations[MMIO_CACHE_ENTRIES];
+	/** Cached region handlers. */
+	struct mmio_region_handler handlers[MMIO_CACHE_ENTRIES];
+};
+
 int mmio_cell_init(struct cell *cell);
 
 void mmio_region_register(struct cell *cell, unsigned long start,
@@ -68,6 +68,8 @@ struct page_pool {
 	unsigned long *used_bitmap;
 	/** Set @c PAGE_SCRUB_ON_FREE to zero-out pages on release. */
 	unsigned long flags;
+	/** Search hint: all pages below this number are in use. */
+	unsigned long first_free;
 };
 
 /**
@@ -363,6 +365,13 @@ void paging_dump_stats(const char *when);
  * @see arch_paging_flush_cpu_caches
  */
 
+/**
+ * @fn void arch_paging_flush_all_tlbs(void)
+ * Flush all TLB entries of the hypervisor address space on the calling CPU.
+ *
+ * @see arch_paging_flush_page_tlbs
+ */
+
 /**
  * @fn void arch_paging_flush_cpu_caches(void *addr, long size)
  * Flush caches related to the specified region.
@@ -41,6 +41,11 @@ struct public_per_cpu {
 
 	/** Statistic counters. */
 	u32 stats[JAILHOUSE_NUM_CPU_STATS];
+#ifdef CONFIG_EXIT_LATENCY_STATS
+	/** Exit latency histograms, indexed by statistic counter and log2
+	 *  bucket. */
+	u32 exit_latency[JAILHOUSE_NUM_CPU_STATS][JAILHOUSE_CPU_LATENCY_BUCKETS];
+#endif
 
 	/** State of the shutdown process. Possible values:
 	 * @li SHUTDOWN_NONE: no shutdown in progress
@@ -79,6 +84,16 @@ struct per_cpu {
 	/** Per-CPU paging structures. */
 	struct paging_structures pg_structs;
 
+	/** Recently dispatched MMIO regions. */
+	struct mmio_cache mmio_cache;
+
+#if defined(CONFIG_EXIT_LATENCY_STATS) || defined(CONFIG_HYPERVISOR_TRACE)
+	/** Timestamp counter value at the beginning of the current VM exit. */
+	u64 exit_timestamp;
+	/** Statistic counter index the current VM exit is attributed to. */
+	unsigned int exit_reason;
+#endif
+
 	ARCH_PERCPU_FIELDS;
 
 	/* Must be last field! */
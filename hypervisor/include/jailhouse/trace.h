@@ -0,0 +1,123 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _JAILHOUSE_TRACE_H
+#define _JAILHOUSE_TRACE_H
+
+#include <jailhouse/entry.h>
+#include <jailhouse/percpu.h>
+#include <jailhouse/processor.h>
+
+/**
+ * @defgroup Trace Hypervisor Trace
+ *
+ * When CONFIG_HYPERVISOR_TRACE is enabled, each CPU records compact
+ * timestamped events into its own ring (struct jailhouse_trace_ring) in
+ * hypervisor memory. The rings are mapped read-only into the root cell so
+ * that they can be consumed via the driver without any hypercall. Without the
+ * option, all services compile to nothing.
+ *
+ * @{
+ */
+
+#ifdef CONFIG_HYPERVISOR_TRACE
+
+/**
+ * Number of events per CPU ring. It has to be a power of two so that slot
+ * indexes stay continuous when the head counter wraps.
+ */
+#define TRACE_RING_EVENTS	2048
+/**
+ * Size of a CPU ring in bytes, including its header. The header costs one
+ * additional page.
+ */
+#define TRACE_RING_SIZE							\
+	PAGE_ALIGN(sizeof(struct jailhouse_trace_ring) +		\
+		   TRACE_RING_EVENTS * sizeof(struct jailhouse_trace_event))
+
+extern void *trace_rings;
+
+/**
+ * Record an event in the ring of the calling CPU.
+ * @param type		Event type (JAILHOUSE_TRACE_*).
+ * @param code		Type-specific code.
+ * @param arg0		First type-specific argument.
+ * @param arg1		Second type-specific argument.
+ * @param timestamp	Timestamp of the event.
+ * @param duration	Duration of the event in timestamp ticks, or 0.
+ */
+static inline void trace_event(u16 type, u16 code, u64 arg0, u64 arg1,
+			       u64 timestamp, u32 duration)
+{
+	struct jailhouse_trace_ring *ring;
+	struct jailhouse_trace_event *event;
+
+	if (!trace_rings)
+		return;
+
+	ring = trace_rings + this_cpu_id() * TRACE_RING_SIZE;
+	event = &ring->events[ring->head & (TRACE_RING_EVENTS - 1)];
+
+	event->timestamp = timestamp;
+	event->arg[0] = arg0;
+	event->arg[1] = arg1;
+	event->duration = duration;
+	event->type = type;
+	event->code = code;
+
+	/* publish the event before readers can see the new head */
+	memory_barrier();
+	ring->head++;
+	/*
+	 * Publish the new head before the slot of the oldest event is
+	 * overwritten by the next one, so that readers detect the reuse.
+	 */
+	memory_barrier();
+}
+
+/**
+ * Record an event that happens now in the ring of the calling CPU.
+ * @param type		Event type (JAILHOUSE_TRACE_*).
+ * @param code		Type-specific code.
+ * @param arg0		First type-specific argument.
+ * @param arg1		Second type-specific argument.
+ */
+static inline void trace_point(u16 type, u16 code, u64 arg0, u64 arg1)
+{
+	if (trace_rings)
+		trace_event(type, code, arg0, arg1, arch_read_timestamp(), 0);
+}
+
+void trace_init(void);
+bool trace_page(unsigned long phys);
+long trace_get_info(unsigned long type);
+
+#else /* !CONFIG_HYPERVISOR_TRACE */
+
+static inline void trace_event(u16 type, u16 code, u64 arg0, u64 arg1,
+			       u64 timestamp, u32 duration) {}
+static inline void trace_point(u16 type, u16 code, u64 arg0, u64 arg1) {}
+
+static inline void trace_init(void) {}
+
+static inline bool trace_page(unsigned long phys)
+{
+	return false;
+}
+
+static inline long trace_get_info(unsigned long type)
+{
+	return -EINVAL;
+}
+
+#endif /* !CONFIG_HYPERVISOR_TRACE */
+
+/** @} */
+
+#endif /* !_JAILHOUSE_TRACE_H */
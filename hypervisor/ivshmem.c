@@ -60,6 +60,8 @@
 
 struct ivshmem_link {
 	struct ivshmem_endpoint eps[IVSHMEM_MAX_PEERS];
+	/** Permanent hypervisor mapping of the shared State Table. */
+	u32 *state_table;
 	unsigned int peers;
 	u16 bdf;
 	struct ivshmem_link *next;
@@ -101,30 +103,43 @@ static void ivshmem_trigger_interrupt(struct ivshmem_endpoint *ive,
 	spin_unlock(&ive->irq_lock);
 }
 
-static u32 *ivshmem_map_state_table(struct ivshmem_endpoint *ive)
+/*
+ * The State Table is mapped once per link into the remapping area. This
+ * keeps page table updates and the related TLB maintenance out of the state
+ * update path.
+ */
+static u32 *ivshmem_map_state_table(const struct jailhouse_memory *state_mem)
 {
-	/*
-	 * Cannot fail: upper levels of page table were already created by
-	 * paging_init, and we always map single pages, thus only update the
-	 * leaf entry and do not have to deal with huge pages.
-	 */
-	paging_create(&this_cpu_data()->pg_structs,
-		      ive->shmem[0].phys_start, PAGE_SIZE,
-		      TEMPORARY_MAPPING_BASE, PAGE_DEFAULT_FLAGS,
-		      PAGING_NON_COHERENT | PAGING_NO_HUGE);
+	void *virt;
 
-	return (u32 *)TEMPORARY_MAPPING_BASE;
+	virt = page_alloc(&remap_pool, 1);
+	if (!virt)
+		return NULL;
+
+	if (paging_create(&hv_paging_structs, state_mem->phys_start, PAGE_SIZE,
+			  (unsigned long)virt, PAGE_DEFAULT_FLAGS,
+			  PAGING_NON_COHERENT | PAGING_NO_HUGE) != 0) {
+		page_free(&remap_pool, virt, 1);
+		return NULL;
+	}
+
+	return virt;
 }
 
+static void ivshmem_unmap_state_table(u32 *state_table)
+{
+	paging_destroy(&hv_paging_structs, (unsigned long)state_table,
+		       PAGE_SIZE, PAGING_NON_COHERENT);
+	page_free(&remap_pool, state_table, 1);
+}
 
 static void ivshmem_write_state(struct ivshmem_endpoint *ive, u32 new_state)
 {
 	const struct jailhouse_pci_device *dev_info = ive->device->info;
-	u32 *state_table = ivshmem_map_state_table(ive);
 	struct ivshmem_endpoint *target_ive;
 	unsigned int id;
 
-	state_table[dev_info->shmem_dev_id] = new_state;
+	ive->link->state_table[dev_info->shmem_dev_id] = new_state;
 	memory_barrier();
 
 	if (ive->state != new_state) {
@@ -399,6 +414,7 @@ enum pci_access ivshmem_pci_cfg_read(struct pci_device *device, u16 address,
 int ivshmem_init(struct cell *cell, struct pci_device *device)
 {
 	const struct jailhouse_pci_device *dev_info = device->info;
+	const struct jailhouse_memory *shmem;
 	struct ivshmem_endpoint *ive;
 	struct ivshmem_link *link;
 	unsigned int peer_id, id;
@@ -420,6 +436,9 @@ int ivshmem_init(struct cell *cell, struct pci_device *device)
 	if (id >= IVSHMEM_MAX_PEERS)
 		return trace_error(-EINVAL);
 
+	shmem = jailhouse_cell_mem_regions(cell->config) +
+		dev_info->shmem_regions_start;
+
 	if (link) {
 		if (link->eps[id].device)
 			return trace_error(-EBUSY);
@@ -435,6 +454,12 @@ int ivshmem_init(struct cell *cell, struct pci_device *device)
 		if (!link)
 			return -ENOMEM;
 
+		link->state_table = ivshmem_map_state_table(&shmem[0]);
+		if (!link->state_table) {
+			page_free(&mem_pool, link, PAGES(sizeof(*link)));
+			return -ENOMEM;
+		}
+
 		link->bdf = dev_info->bdf;
 		link->next = ivshmem_links;
 		ivshmem_links = link;
@@ -445,10 +470,9 @@ int ivshmem_init(struct cell *cell, struct pci_device *device)
 
 	ive->device = device;
 	ive->link = link;
-	ive->shmem = jailhouse_cell_mem_regions(cell->config) +
-		dev_info->shmem_regions_start;
+	ive->shmem = shmem;
 	if (link->peers == 1)
-		memset(ivshmem_map_state_table(ive), 0,
+		memset(link->state_table, 0,
 		       dev_info->shmem_peers * sizeof(u32));
 	device->ivshmem_endpoint = ive;
 
@@ -544,6 +568,7 @@ void ivshmem_exit(struct pci_device *device)
 			continue;
 
 		*linkp = ive->link->next;
+		ivshmem_unmap_state_table(ive->link->state_table);
 		page_free(&mem_pool, ive->link, PAGES(sizeof(*ive->link)));
 		break;
 	}
@@ -15,9 +15,17 @@
 #include <jailhouse/mmio.h>
 #include <jailhouse/paging.h>
 #include <jailhouse/printk.h>
+#include <jailhouse/trace.h>
 #include <jailhouse/unit.h>
 #include <jailhouse/percpu.h>
 
+/*
+ * Lower bound for the MMIO generation of newly created cells. It is advanced
+ * beyond the final generation of each destroyed cell so that a cell allocated
+ * at the same address can never match stale per-CPU cache entries.
+ */
+static unsigned long mmio_generation_base;
+
 /**
  * Perform MMIO-specific initialization for a new cell.
  * @param cell		Cell to be initialized.
@@ -34,6 +42,8 @@ int mmio_cell_init(struct cell *cell)
 	void *pages;
 
 	/* cell is zero-initialized */;
+	cell->mmio_generation = mmio_generation_base;
+
 	for_each_unit(unit)
 		cell->max_mmio_regions += unit->mmio_count_regions(cell);
 
@@ -116,7 +126,7 @@ void mmio_region_register(struct cell *cell, unsigned long start,
 }
 
 static int find_region(struct cell *cell, unsigned long address,
-		       unsigned int size, unsigned long *region_base,
+		       unsigned int size, struct mmio_region_location *location,
 		       struct mmio_region_handler *handler)
 {
 	unsigned int range_start, range_size, index;
@@ -164,8 +174,8 @@ restart:
 			range_size -= index + 1 - range_start;
 			range_start = index + 1;
 		} else {
-			if (region_base != NULL) {
-				*region_base = region.start;
+			if (location != NULL) {
+				*location = region;
 				*handler = cell->mmio_handlers[index];
 			}
 
@@ -239,14 +249,55 @@ void mmio_region_unregister(struct cell *cell, unsigned long start)
  */
 enum mmio_result mmio_handle_access(struct mmio_access *mmio)
 {
+	struct mmio_cache *cache = &this_cpu_data()->mmio_cache;
+	struct mmio_region_location location;
 	struct mmio_region_handler handler;
-	unsigned long region_base;
+	struct cell *cell = this_cell();
+	unsigned long generation;
+	unsigned int n;
 
-	if (find_region(this_cell(), mmio->address, mmio->size, &region_base,
+	/*
+	 * The cached entries are only valid as long as the generation they
+	 * were filled at is still current. A generation read prior to the
+	 * lookup via find_region is sufficient as tag: the generation only
+	 * increases, so the entry can only match again if the region table
+	 * did not change in the meantime.
+	 */
+	generation = cell->mmio_generation;
+	if (cache->cell != cell || cache->generation != generation) {
+		cache->cell = cell;
+		cache->generation = generation;
+		cache->valid = 0;
+		cache->next = 0;
+	}
+
+	for (n = 0; n < cache->valid; n++) {
+		location = cache->locations[n];
+		if (mmio->address >= location.start &&
+		    location.start + location.size >=
+		    mmio->address + mmio->size) {
+			this_cpu_public()->
+				stats[JAILHOUSE_CPU_STAT_MMIO_CACHE_HITS]++;
+			handler = cache->handlers[n];
+			goto dispatch;
+		}
+	}
+
+	if (find_region(cell, mmio->address, mmio->size, &location,
 			&handler) < 0)
 		return MMIO_UNHANDLED;
 
-	mmio->address -= region_base;
+	n = cache->next;
+	cache->next = (n + 1) % MMIO_CACHE_ENTRIES;
+	if (cache->valid < MMIO_CACHE_ENTRIES)
+		cache->valid++;
+	cache->locations[n] = location;
+	cache->handlers[n] = handler;
+
+dispatch:
+	trace_point(JAILHOUSE_TRACE_MMIO, mmio->is_write, mmio->address,
+		    (unsigned long)handler.function);
+	mmio->address -= location.start;
 	return handler.function(handler.arg, mmio);
 }
 
@@ -258,6 +309,9 @@ enum mmio_result mmio_handle_access(struct mmio_access *mmio)
  */
 void mmio_cell_exit(struct cell *cell)
 {
+	if (cell->mmio_generation >= mmio_generation_base)
+		mmio_generation_base = cell->mmio_generation + 2;
+
 	page_free(&mem_pool, cell->mmio_locations,
 		  PAGES(cell->max_mmio_regions *
 			(sizeof(struct mmio_region_location) +
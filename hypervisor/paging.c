@@ -19,8 +19,14 @@
 
 #define INVALID_PAGE_NR		(~0UL)
 
+#define PAGES_TO_BMP_WORDS(pages) \
+	(((pages) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
 #define PAGE_SCRUB_ON_FREE	0x1
 
+/* Larger hypervisor ranges are flushed from the TLB at once. */
+#define TLB_FLUSH_MAX_PAGES	16
+
 /**
  * Offset between virtual and physical hypervisor addresses.
  *
@@ -58,35 +64,67 @@ unsigned long paging_get_phys_invalid(pt_entry_t pte, unsigned long virt)
 	return INVALID_PHYS_ADDR;
 }
 
-static unsigned long find_next_free_page(struct page_pool *pool,
-					 unsigned long start)
+/**
+ * Find the next free or used page in a pool.
+ * @param pool		Page pool to search.
+ * @param start		Page number to start the search at.
+ * @param used		Search for a used page if true, for a free one
+ * 			otherwise.
+ *
+ * @return Number of the first matching page or @c INVALID_PAGE_NR if there is
+ * 	   none.
+ */
+static unsigned long find_next_page(struct page_pool *pool,
+				    unsigned long start, bool used)
 {
 	unsigned long bmp_pos, bmp_val, page_nr;
-	unsigned long start_mask = 0;
 
 	if (start >= pool->pages)
 		return INVALID_PAGE_NR;
 
-	/*
-	 * If we don't start on the beginning of a bitmap word, create a mask
-	 * to mark the pages before the start page as (virtually) used.
-	 */
-	if (start % BITS_PER_LONG > 0)
-		start_mask = ~0UL >> (BITS_PER_LONG - (start % BITS_PER_LONG));
-
-	for (bmp_pos = start / BITS_PER_LONG;
-	     bmp_pos < pool->pages / BITS_PER_LONG; bmp_pos++) {
-		bmp_val = pool->used_bitmap[bmp_pos] | start_mask;
-		start_mask = 0;
-		if (bmp_val != ~0UL) {
-			page_nr = ffzl(bmp_val) + bmp_pos * BITS_PER_LONG;
-			if (page_nr >= pool->pages)
-				break;
-			return page_nr;
-		}
+	bmp_pos = start / BITS_PER_LONG;
+	bmp_val = used ? pool->used_bitmap[bmp_pos] :
+		~pool->used_bitmap[bmp_pos];
+	/* Ignore the pages before the start page. */
+	bmp_val &= ~0UL << (start % BITS_PER_LONG);
+
+	while (bmp_val == 0) {
+		if (++bmp_pos >= PAGES_TO_BMP_WORDS(pool->pages))
+			return INVALID_PAGE_NR;
+		bmp_val = used ? pool->used_bitmap[bmp_pos] :
+			~pool->used_bitmap[bmp_pos];
 	}
 
-	return INVALID_PAGE_NR;
+	page_nr = ffsl(bmp_val) + bmp_pos * BITS_PER_LONG;
+	return page_nr < pool->pages ? page_nr : INVALID_PAGE_NR;
+}
+
+/**
+ * Mark a range of pages as used or free.
+ * @param pool		Page pool the pages belong to.
+ * @param start		Number of the first page.
+ * @param num		Number of pages.
+ * @param used		Mark pages as used if true, as free otherwise.
+ */
+static void mark_pages(struct page_pool *pool, unsigned long start,
+		       unsigned long num, bool used)
+{
+	unsigned long end = start + num;
+	unsigned long bmp_pos, mask;
+
+	while (start < end) {
+		bmp_pos = start / BITS_PER_LONG;
+		mask = ~0UL << (start % BITS_PER_LONG);
+		if (end - bmp_pos * BITS_PER_LONG < BITS_PER_LONG)
+			mask &= ~(~0UL << (end % BITS_PER_LONG));
+
+		if (used)
+			pool->used_bitmap[bmp_pos] |= mask;
+		else
+			pool->used_bitmap[bmp_pos] &= ~mask;
+
+		start = (bmp_pos + 1) * BITS_PER_LONG;
+	}
 }
 
 /**
@@ -97,47 +135,52 @@ static unsigned long find_next_free_page(struct page_pool *pool,
  *
  * @return Pointer to first page or NULL if allocation failed.
  *
+ * @note The search operates on full bitmap words and continues behind the
+ * blocking page when a candidate range turns out to be too short.
+ *
  * @see page_free
  */
 static void *page_alloc_internal(struct page_pool *pool, unsigned int num,
 				 unsigned long align_mask)
 {
-	unsigned long aligned_start, pool_start, next, start, last;
-	unsigned int allocated;
+	unsigned long aligned_start, pool_start, start, used;
+
+	if (num == 0)
+		return NULL;
 
 	pool_start = (unsigned long)pool->base_address >> PAGE_SHIFT;
 
 	/* The pool itself might not be aligned as required. */
 	aligned_start = ((pool_start + align_mask) & ~align_mask) - pool_start;
-	next = aligned_start;
-
-restart:
-	/* Forward the search start to the next aligned page. */
-	if ((next - aligned_start) & align_mask)
-		next += num - ((next - aligned_start) & align_mask);
 
-	start = next = find_next_free_page(pool, next);
-	if (start == INVALID_PAGE_NR || num == 0)
-		return NULL;
+	start = pool->first_free > aligned_start ?
+		pool->first_free : aligned_start;
 
-	/* Enforce alignment (none of align_mask is 0). */
-	if ((start - aligned_start) & align_mask)
-		goto restart;
+	while (1) {
+		start = find_next_page(pool, start, false);
+		if (start == INVALID_PAGE_NR)
+			return NULL;
 
-	for (allocated = 1, last = start; allocated < num;
-	     allocated++, last = next) {
-		next = find_next_free_page(pool, last + 1);
-		if (next == INVALID_PAGE_NR)
+		/* Forward the start to the next aligned page. */
+		start = aligned_start +
+			((start - aligned_start + align_mask) & ~align_mask);
+		if (start + num > pool->pages)
 			return NULL;
-		if (next != last + 1)
-			goto restart;	/* not consecutive */
-	}
 
-	for (allocated = 0; allocated < num; allocated++)
-		set_bit(start + allocated, pool->used_bitmap);
+		used = find_next_page(pool, start, true);
+		if (used == INVALID_PAGE_NR || used >= start + num)
+			break;
+
+		/* not consecutive, continue behind the used page */
+		start = used + 1;
+	}
 
+	mark_pages(pool, start, num, true);
 	pool->used_pages += num;
 
+	if (start == pool->first_free)
+		pool->first_free = start + num;
+
 	return pool->base_address + start * PAGE_SIZE;
 }
 
@@ -181,16 +224,47 @@ void page_free(struct page_pool *pool, void *page, unsigned int num)
 {
 	unsigned long page_nr;
 
-	if (!page)
+	if (!page || num == 0)
 		return;
 
-	while (num-- > 0) {
-		if (pool->flags & PAGE_SCRUB_ON_FREE)
-			memset(page, 0, PAGE_SIZE);
-		page_nr = (page - pool->base_address) / PAGE_SIZE;
-		clear_bit(page_nr, pool->used_bitmap);
-		pool->used_pages--;
-		page += PAGE_SIZE;
+	if (pool->flags & PAGE_SCRUB_ON_FREE)
+		memset(page, 0, num * PAGE_SIZE);
+
+	page_nr = (page - pool->base_address) / PAGE_SIZE;
+	mark_pages(pool, page_nr, num, false);
+	pool->used_pages -= num;
+
+	if (page_nr < pool->first_free)
+		pool->first_free = page_nr;
+}
+
+/**
+ * Collect fragmentation statistics of a page pool.
+ * @param pool		Page pool to analyze.
+ * @param blocks	Receives the number of free blocks, i.e. runs of
+ * 			consecutive free pages.
+ * @param largest	Receives the number of pages of the largest free block.
+ */
+static void page_pool_fragmentation(struct page_pool *pool,
+				    unsigned long *blocks,
+				    unsigned long *largest)
+{
+	unsigned long start = pool->first_free, end;
+
+	*blocks = *largest = 0;
+
+	while (1) {
+		start = find_next_page(pool, start, false);
+		if (start == INVALID_PAGE_NR)
+			break;
+		end = find_next_page(pool, start, true);
+		if (end == INVALID_PAGE_NR)
+			end = pool->pages;
+
+		(*blocks)++;
+		if (end - start > *largest)
+			*largest = end - start;
+		start = end;
 	}
 }
 
@@ -235,6 +309,25 @@ static void flush_pt_entry(pt_entry_t pte, unsigned long paging_flags)
 		arch_paging_flush_cpu_caches(pte, sizeof(*pte));
 }
 
+/*
+ * Flush the hypervisor TLB entries of a modified range. Small ranges are
+ * flushed page-wise, larger ones in a single step.
+ */
+static void flush_tlbs(const struct paging_structures *pg_structs,
+		       unsigned long virt, unsigned long size)
+{
+	if (!pg_structs->hv_paging)
+		return;
+
+	if (size > TLB_FLUSH_MAX_PAGES * PAGE_SIZE) {
+		arch_paging_flush_all_tlbs();
+		return;
+	}
+
+	for (; size > 0; size -= PAGE_SIZE, virt += PAGE_SIZE)
+		arch_paging_flush_page_tlbs(virt);
+}
+
 static int split_hugepage(bool hv_paging, const struct paging *paging,
 			  pt_entry_t pte, unsigned long virt,
 			  unsigned long paging_flags)
@@ -264,6 +357,79 @@ static int split_hugepage(bool hv_paging, const struct paging *paging,
 			     flags, paging_flags);
 }
 
+/*
+ * Map the part of the region that is covered by the given page table,
+ * advancing phys, virt and size accordingly. Table entries are visited in
+ * ascending order, so the walk left the table when the entry of the next
+ * address is not above the current one.
+ */
+static int create_range(const struct paging_structures *pg_structs,
+			const struct paging *paging, page_table_t pt,
+			unsigned long *phys, unsigned long *virt,
+			unsigned long *size, unsigned long access_flags,
+			unsigned long paging_flags)
+{
+	struct paging_structures sub_structs;
+	pt_entry_t pte, prev_pte;
+	page_table_t next_pt;
+	int err;
+
+	pte = paging->get_entry(pt, *virt);
+	do {
+		if (paging->page_size > 0 &&
+		    paging->page_size <= *size &&
+		    ((*phys | *virt) & (paging->page_size - 1)) == 0 &&
+		    (paging_flags & PAGING_HUGE ||
+		     paging->page_size == PAGE_SIZE)) {
+			/*
+			 * We might be overwriting a more fine-grained
+			 * mapping, so release it first. This cannot fail as
+			 * we are working along hugepage boundaries.
+			 */
+			if (paging->page_size > PAGE_SIZE) {
+				sub_structs.root_paging = paging;
+				sub_structs.root_table = pt;
+				sub_structs.hv_paging = pg_structs->hv_paging;
+				paging_destroy(&sub_structs, *virt,
+					       paging->page_size,
+					       paging_flags);
+			}
+			paging->set_terminal(pte, *phys, access_flags);
+			flush_pt_entry(pte, paging_flags);
+
+			*phys += paging->page_size;
+			*virt += paging->page_size;
+			*size -= paging->page_size;
+		} else {
+			if (paging->entry_valid(pte, PAGE_PRESENT_FLAGS)) {
+				err = split_hugepage(pg_structs->hv_paging,
+						     paging, pte, *virt,
+						     paging_flags);
+				if (err)
+					return err;
+				next_pt = paging_phys2hvirt(
+						paging->get_next_pt(pte));
+			} else {
+				next_pt = page_alloc(&mem_pool, 1);
+				if (!next_pt)
+					return -ENOMEM;
+				paging->set_next_pt(pte,
+						    paging_hvirt2phys(next_pt));
+				flush_pt_entry(pte, paging_flags);
+			}
+			err = create_range(pg_structs, paging + 1, next_pt,
+					   phys, virt, size, access_flags,
+					   paging_flags);
+			if (err)
+				return err;
+		}
+		prev_pte = pte;
+		pte = paging->get_entry(pt, *virt);
+	} while (*size > 0 && pte > prev_pte);
+
+	return 0;
+}
+
 /**
  * Create or modify a page map.
  * @param pg_structs	Descriptor of paging structures to be used.
@@ -286,68 +452,103 @@ int paging_create(const struct paging_structures *pg_structs,
 		  unsigned long phys, unsigned long size, unsigned long virt,
 		  unsigned long access_flags, unsigned long paging_flags)
 {
+	unsigned long start, remaining;
+	int err = 0;
+
 	phys &= PAGE_MASK;
 	virt &= PAGE_MASK;
 	size = PAGE_ALIGN(size);
 
-	while (size > 0) {
-		const struct paging *paging = pg_structs->root_paging;
-		page_table_t pt = pg_structs->root_table;
-		struct paging_structures sub_structs;
-		pt_entry_t pte;
-		int err;
-
-		while (1) {
-			pte = paging->get_entry(pt, virt);
-			if (paging->page_size > 0 &&
-			    paging->page_size <= size &&
-			    ((phys | virt) & (paging->page_size - 1)) == 0 &&
-			    (paging_flags & PAGING_HUGE ||
-			     paging->page_size == PAGE_SIZE)) {
-				/*
-				 * We might be overwriting a more fine-grained
-				 * mapping, so release it first. This cannot
-				 * fail as we are working along hugepage
-				 * boundaries.
-				 */
-				if (paging->page_size > PAGE_SIZE) {
-					sub_structs.root_paging = paging;
-					sub_structs.root_table = pt;
-					sub_structs.hv_paging =
-						pg_structs->hv_paging;
-					paging_destroy(&sub_structs, virt,
-						       paging->page_size,
-						       paging_flags);
-				}
-				paging->set_terminal(pte, phys, access_flags);
-				flush_pt_entry(pte, paging_flags);
-				break;
-			}
-			if (paging->entry_valid(pte, PAGE_PRESENT_FLAGS)) {
-				err = split_hugepage(pg_structs->hv_paging,
-						     paging, pte, virt,
-						     paging_flags);
-				if (err)
-					return err;
-				pt = paging_phys2hvirt(
-						paging->get_next_pt(pte));
-			} else {
-				pt = page_alloc(&mem_pool, 1);
-				if (!pt)
-					return -ENOMEM;
-				paging->set_next_pt(pte,
-						    paging_hvirt2phys(pt));
+	start = virt;
+	remaining = size;
+	while (remaining > 0 && !err)
+		err = create_range(pg_structs, pg_structs->root_paging,
+				   pg_structs->root_table, &phys, &virt,
+				   &remaining, access_flags, paging_flags);
+
+	flush_tlbs(pg_structs, start, size);
+
+	return err;
+}
+
+/*
+ * Smallest step by which an invalid entry of the given level can be skipped.
+ * Levels without terminal entries use the step of the next level.
+ */
+static unsigned long skip_size(const struct paging *paging)
+{
+	while (paging->page_size == 0)
+		paging++;
+	return paging->page_size;
+}
+
+/*
+ * Advance virt to the next multiple of step and reduce size accordingly. This
+ * also works when virt wraps to exactly 0 at the end of the address space
+ * (e.g. a 512MB region starting at 0xe0000000 with 32-bit addresses).
+ */
+static void skip_to(unsigned long *virt, unsigned long *size,
+		    unsigned long step)
+{
+	unsigned long skip = step - (*virt & (step - 1));
+
+	if (skip >= *size) {
+		*size = 0;
+	} else {
+		*virt += skip;
+		*size -= skip;
+	}
+}
+
+/*
+ * Unmap the part of the region that is covered by the given page table and
+ * release sub-tables that became empty. See create_range for the walk.
+ */
+static int destroy_range(const struct paging_structures *pg_structs,
+			 const struct paging *paging, page_table_t pt,
+			 unsigned long *virt, unsigned long *size,
+			 unsigned long paging_flags)
+{
+	pt_entry_t pte, prev_pte;
+	page_table_t next_pt;
+	int err;
+
+	pte = paging->get_entry(pt, *virt);
+	do {
+		if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS)) {
+			skip_to(virt, size, skip_size(paging));
+		} else if (paging->get_phys(pte, *virt) != INVALID_PHYS_ADDR &&
+			   (*virt & (paging->page_size - 1)) == 0 &&
+			   *size >= paging->page_size) {
+			paging->clear_entry(pte);
+			flush_pt_entry(pte, paging_flags);
+			skip_to(virt, size, paging->page_size);
+		} else {
+			/*
+			 * If the region to be unmapped doesn't fully cover the
+			 * hugepage, the hugepage will need to be split.
+			 */
+			err = split_hugepage(pg_structs->hv_paging, paging,
+					     pte, *virt, paging_flags);
+			if (err)
+				return err;
+
+			next_pt = paging_phys2hvirt(paging->get_next_pt(pte));
+			err = destroy_range(pg_structs, paging + 1, next_pt,
+					    virt, size, paging_flags);
+			if (err)
+				return err;
+
+			if (paging->page_table_empty(next_pt)) {
+				paging->clear_entry(pte);
 				flush_pt_entry(pte, paging_flags);
+				page_free(&mem_pool, next_pt, 1);
 			}
-			paging++;
 		}
-		if (pg_structs->hv_paging)
-			arch_paging_flush_page_tlbs(virt);
+		prev_pte = pte;
+		pte = paging->get_entry(pt, *virt);
+	} while (*size > 0 && pte >= prev_pte);
 
-		phys += paging->page_size;
-		virt += paging->page_size;
-		size -= paging->page_size;
-	}
 	return 0;
 }
 
@@ -371,82 +572,20 @@ int paging_destroy(const struct paging_structures *pg_structs,
 		   unsigned long virt, unsigned long size,
 		   unsigned long paging_flags)
 {
-	size = PAGE_ALIGN(size);
+	unsigned long start = virt, remaining;
+	int err = 0;
 
-	while (size > 0) {
-		const struct paging *paging = pg_structs->root_paging;
-		page_table_t pt[MAX_PAGE_TABLE_LEVELS];
-		unsigned long page_size;
-		pt_entry_t pte;
-		int n = 0;
-		int err;
-
-		/* walk down the page table, saving intermediate tables */
-		pt[0] = pg_structs->root_table;
-		while (1) {
-			pte = paging->get_entry(pt[n], virt);
-			if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS))
-				break;
-			if (paging->get_phys(pte, virt) != INVALID_PHYS_ADDR) {
-				unsigned long page_start;
-
-				/*
-				 * If the region to be unmapped doesn't fully
-				 * cover the hugepage, the hugepage will need to
-				 * be split.
-				 */
-				page_size = paging->page_size ?
-					paging->page_size : PAGE_SIZE;
-				page_start = virt & ~(page_size-1);
-
-				/*
-				 * It's possible that virt + size overflows to
-				 * exactly 0 (e.g. a 512MB region starting at
-				 * 0xe0000000 with 32-bit addresses) during
-				 * normal execution. Any overflow beyond that is
-				 * a programming error.
-				 *
-				 * To handle this case, subtract 1 from the size
-				 * when comparing both sides. Note that size and
-				 * page_size are always > 0, so there's no risk
-				 * of underflow.
-				 */
-				if (virt <= page_start &&
-				    virt + (size - 1) >=
-				    page_start + (page_size - 1))
-					break;
+	size = PAGE_ALIGN(size);
 
-				err = split_hugepage(pg_structs->hv_paging,
-						     paging, pte, virt,
-						     paging_flags);
-				if (err)
-					return err;
-			}
-			pt[++n] = paging_phys2hvirt(paging->get_next_pt(pte));
-			paging++;
-		}
-		/* advance by page size of current level paging */
-		page_size = paging->page_size ? paging->page_size : PAGE_SIZE;
+	remaining = size;
+	while (remaining > 0 && !err)
+		err = destroy_range(pg_structs, pg_structs->root_paging,
+				    pg_structs->root_table, &virt, &remaining,
+				    paging_flags);
 
-		/* walk up again, clearing entries, releasing empty tables */
-		while (1) {
-			paging->clear_entry(pte);
-			flush_pt_entry(pte, paging_flags);
-			if (n == 0 || !paging->page_table_empty(pt[n]))
-				break;
-			page_free(&mem_pool, pt[n], 1);
-			paging--;
-			pte = paging->get_entry(pt[--n], virt);
-		}
-		if (pg_structs->hv_paging)
-			arch_paging_flush_page_tlbs(virt);
+	flush_tlbs(pg_structs, start, size);
 
-		if (page_size > size)
-			break;
-		virt += page_size;
-		size -= page_size;
-	}
-	return 0;
+	return err;
 }
 
 static unsigned long
@@ -657,8 +796,8 @@ int paging_init(void)
 		(unsigned long *)(__page_pool + per_cpu_pages * PAGE_SIZE +
 				  config_pages * PAGE_SIZE);
 	mem_pool.used_pages = per_cpu_pages + config_pages + bitmap_pages;
-	for (n = 0; n < mem_pool.used_pages; n++)
-		set_bit(n, mem_pool.used_bitmap);
+	mark_pages(&mem_pool, 0, mem_pool.used_pages, true);
+	mem_pool.first_free = mem_pool.used_pages;
 	mem_pool.flags = PAGE_SCRUB_ON_FREE;
 
 	remap_pool.used_bitmap = page_alloc(&mem_pool, NUM_REMAP_BITMAP_PAGES);
@@ -722,7 +861,15 @@ int paging_init(void)
  */
 void paging_dump_stats(const char *when)
 {
+	unsigned long mem_blocks, mem_largest, remap_blocks, remap_largest;
+
+	page_pool_fragmentation(&mem_pool, &mem_blocks, &mem_largest);
+	page_pool_fragmentation(&remap_pool, &remap_blocks, &remap_largest);
+
 	printk("Page pool usage %s: mem %ld/%ld, remap %ld/%ld\n", when,
 	       mem_pool.used_pages, mem_pool.pages,
 	       remap_pool.used_pages, remap_pool.pages);
+	printk("Free page blocks: mem %ld (largest %ld), "
+	       "remap %ld (largest %ld)\n", mem_blocks, mem_largest,
+	       remap_blocks, remap_largest);
 }
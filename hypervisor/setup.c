@@ -18,6 +18,7 @@
 #include <jailhouse/paging.h>
 #include <jailhouse/control.h>
 #include <jailhouse/string.h>
+#include <jailhouse/trace.h>
 #include <jailhouse/unit.h>
 #include <generated/version.h>
 #include <asm/spinlock.h>
@@ -67,13 +68,16 @@ static void init_early(unsigned int cpu_id)
 	if (error)
 		return;
 
+	trace_init();
+
 	/*
 	 * Back the region of the hypervisor core and per-CPU page with empty
 	 * pages for Linux. This allows to fault-in the hypervisor region into
 	 * Linux' page table before shutdown without triggering violations.
 	 *
 	 * Allow read access to the console page, if the hypervisor has the
-	 * debug console flag JAILHOUSE_SYS_VIRTUAL_DEBUG_CONSOLE set.
+	 * debug console flag JAILHOUSE_SYS_VIRTUAL_DEBUG_CONSOLE set, and to
+	 * the trace rings, if CONFIG_HYPERVISOR_TRACE is enabled.
 	 */
 	hyp_phys_start = system_config->hypervisor_memory.phys_start;
 	hyp_phys_end = hyp_phys_start + system_config->hypervisor_memory.size;
@@ -85,6 +89,8 @@ static void init_early(unsigned int cpu_id)
 		if (virtual_console &&
 		    hv_page.virt_start == paging_hvirt2phys(&console))
 			hv_page.phys_start = paging_hvirt2phys(&console);
+		else if (trace_page(hv_page.virt_start))
+			hv_page.phys_start = hv_page.virt_start;
 		else
 			hv_page.phys_start = paging_hvirt2phys(empty_page);
 		error = arch_map_memory_region(&root_cell, &hv_page);
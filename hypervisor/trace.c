@@ -0,0 +1,93 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <jailhouse/control.h>
+#include <jailhouse/paging.h>
+#include <jailhouse/printk.h>
+#include <jailhouse/trace.h>
+
+#ifdef CONFIG_HYPERVISOR_TRACE
+
+void *trace_rings;
+
+static unsigned long trace_offset(void)
+{
+	return paging_hvirt2phys(trace_rings) -
+		system_config->hypervisor_memory.phys_start;
+}
+
+/**
+ * Allocate and initialize the trace rings of all CPUs. If there is not
+ * enough memory, tracing stays disabled.
+ */
+void trace_init(void)
+{
+	unsigned int max_cpus = hypervisor_header.max_cpus;
+	struct jailhouse_trace_ring *ring;
+	unsigned int cpu;
+	void *rings;
+
+	rings = page_alloc(&mem_pool,
+			   max_cpus * TRACE_RING_SIZE / PAGE_SIZE);
+	if (!rings) {
+		printk("WARNING: Not enough memory for trace rings, tracing "
+		       "disabled\n");
+		return;
+	}
+
+	for (cpu = 0; cpu < max_cpus; cpu++) {
+		ring = rings + cpu * TRACE_RING_SIZE;
+		ring->size = TRACE_RING_EVENTS;
+		ring->cpu_id = cpu;
+		ring->stride = TRACE_RING_SIZE;
+	}
+
+	trace_rings = rings;
+}
+
+/**
+ * Check if a physical page belongs to the trace rings.
+ * @param phys		Physical address of the page.
+ *
+ * @return True if the page is part of the trace rings.
+ */
+bool trace_page(unsigned long phys)
+{
+	unsigned long start;
+
+	if (!trace_rings)
+		return false;
+
+	start = paging_hvirt2phys(trace_rings);
+	return phys >= start &&
+		phys < start + hypervisor_header.max_cpus * TRACE_RING_SIZE;
+}
+
+/**
+ * Provide information about the trace rings to the root cell.
+ * @param type		Information type (JAILHOUSE_INFO_TRACE_*).
+ *
+ * @return Requested value or negative error code.
+ */
+long trace_get_info(unsigned long type)
+{
+	if (!trace_rings)
+		return -EINVAL;
+
+	switch (type) {
+	case JAILHOUSE_INFO_TRACE_OFFSET:
+		return trace_offset();
+	case JAILHOUSE_INFO_TRACE_SIZE:
+		return TRACE_RING_SIZE;
+	default:
+		return -EINVAL;
+	}
+}
+
+#endif /* CONFIG_HYPERVISOR_TRACE */
@@ -44,8 +44,8 @@
 #define JAILHOUSE_CALL_CLOBBERED	"r3"
 
 /* CPU statistics, arm-specific part */
-#define JAILHOUSE_CPU_STAT_VMEXITS_CP15		JAILHOUSE_GENERIC_CPU_STATS + 5
-#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 6
+#define JAILHOUSE_CPU_STAT_VMEXITS_CP15		JAILHOUSE_GENERIC_CPU_STATS + 6
+#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 7
 
 #ifndef __ASSEMBLY__
 typedef __u32 __jh_arg;
@@ -43,7 +43,7 @@
 #define JAILHOUSE_CALL_CLOBBERED	"x3"
 
 /* CPU statistics, arm64-specific part */
-#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 5
+#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 6
 
 #ifndef __ASSEMBLY__
 typedef __u64 __jh_arg;
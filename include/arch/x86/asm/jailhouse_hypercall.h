@@ -64,7 +64,9 @@
 #define JAILHOUSE_CPU_STAT_VMEXITS_MSR_OTHER	JAILHOUSE_GENERIC_CPU_STATS + 6
 #define JAILHOUSE_CPU_STAT_VMEXITS_MSR_X2APIC_ICR \
 						JAILHOUSE_GENERIC_CPU_STATS + 7
-#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 8
+#define JAILHOUSE_CPU_STAT_IOMMU_INV_PAGE	JAILHOUSE_GENERIC_CPU_STATS + 8
+#define JAILHOUSE_CPU_STAT_IOMMU_INV_DOMAIN	JAILHOUSE_GENERIC_CPU_STATS + 9
+#define JAILHOUSE_NUM_CPU_STATS			JAILHOUSE_GENERIC_CPU_STATS + 10
 
 /* CPUID interface */
 #define JAILHOUSE_CPUID_SIGNATURE		0x40000000
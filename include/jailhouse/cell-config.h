@@ -57,6 +57,25 @@
 #define JAILHOUSE_CELL_PASSIVE_COMMREG	0x00000001
 #define JAILHOUSE_CELL_TEST_DEVICE	0x00000002
 #define JAILHOUSE_CELL_AARCH32		0x00000004
+/*
+ * Only evaluated on x86: Cache decoded MMIO instructions per CPU, keyed by
+ * guest paging root and instruction pointer. The cell guarantees that code
+ * performing MMIO accesses is neither modified nor remapped while running.
+ */
+#define JAILHOUSE_CELL_MMIO_DECODE_CACHE	0x00000008
+/*
+ * Only evaluated on Intel x86: Let VT-d translate DMA requests of the cell's
+ * devices via the EPT instead of separate page tables, if the hardware
+ * permits. DMA is then possible to all memory regions of the cell with the
+ * access rights of the CPU, independent of JAILHOUSE_MEM_DMA.
+ */
+#define JAILHOUSE_CELL_SHARED_DMA_PT		0x00000010
+/*
+ * Only evaluated on Intel x86: Let the cell read xAPIC registers directly
+ * instead of trapping every access via the APIC access page. Writes are still
+ * intercepted and filtered. This is the default behavior on AMD.
+ */
+#define JAILHOUSE_CELL_XAPIC_DIRECT_READ	0x00000020
 
 /*
  * The flag JAILHOUSE_CELL_VIRTUAL_CONSOLE_PERMITTED allows inmates to invoke
@@ -57,10 +57,13 @@
 #define JAILHOUSE_INFO_REMAP_POOL_SIZE		2
 #define JAILHOUSE_INFO_REMAP_POOL_USED		3
 #define JAILHOUSE_INFO_NUM_CELLS		4
+#define JAILHOUSE_INFO_TRACE_OFFSET		5
+#define JAILHOUSE_INFO_TRACE_SIZE		6
 
 /* Hypervisor information type */
 #define JAILHOUSE_CPU_INFO_STATE		0
 #define JAILHOUSE_CPU_INFO_STAT_BASE		1000
+#define JAILHOUSE_CPU_INFO_LATENCY_BASE		2000
 
 /* CPU state */
 #define JAILHOUSE_CPU_RUNNING			0
@@ -71,7 +74,15 @@
 #define JAILHOUSE_CPU_STAT_VMEXITS_MMIO		1
 #define JAILHOUSE_CPU_STAT_VMEXITS_MANAGEMENT	2
 #define JAILHOUSE_CPU_STAT_VMEXITS_HYPERCALL	3
-#define JAILHOUSE_GENERIC_CPU_STATS		4
+#define JAILHOUSE_CPU_STAT_MMIO_CACHE_HITS	4
+#define JAILHOUSE_GENERIC_CPU_STATS		5
+
+/*
+ * Exit latency histograms: JAILHOUSE_CPU_INFO_LATENCY_BASE +
+ * stat * JAILHOUSE_CPU_LATENCY_BUCKETS + bucket, bucket n counting exits that
+ * took [2^n, 2^(n+1)) timestamp counter ticks (bucket 0 also includes 0).
+ */
+#define JAILHOUSE_CPU_LATENCY_BUCKETS		32
 
 #define JAILHOUSE_MSG_NONE			0
 
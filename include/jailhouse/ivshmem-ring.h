@@ -0,0 +1,356 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Lock-free message rings on top of ivshmem-v2 output sections, shared by
+ * inmates and Linux user space.
+ *
+ * Each peer owns one transmit ring in its output section and sends to a
+ * single target peer. The consumer state of a ring is kept in the output
+ * section of the receiving peer, so every field has exactly one writer. A
+ * peer that receives from multiple producers polls one ring per sender.
+ *
+ * Output section layout:
+ *   cons[IVSHM_RING_MAX_PEERS]	consumer state of the rings received by
+ *				this peer, indexed by sender ID
+ *   ctrl			producer state of the transmit ring
+ *   slots			ctrl.num_slots * ctrl.slot_size bytes
+ *
+ * Messages are written into and read from the slots in place. Producers
+ * publish batches of messages and only need to ring the doorbell if the
+ * consumer announced that it is about to wait for an interrupt, i.e. a
+ * polling consumer receives no interrupts at all.
+ *
+ * Both sides have to (re-)initialize their rings before using them, peers
+ * should synchronize on the ivshmem state table for this.
+ */
+
+#ifndef _JAILHOUSE_IVSHMEM_RING_H
+#define _JAILHOUSE_IVSHMEM_RING_H
+
+#define IVSHM_RING_CACHELINE		64
+#define IVSHM_RING_MAX_PEERS		16
+
+#define ivshm_ring_load_acquire(p)	__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ivshm_ring_store_release(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+struct ivshm_ring_cons {
+	/** Number of messages consumed so far. */
+	__u32 tail;
+	/** Non-zero if the consumer waits for a doorbell interrupt. */
+	__u32 wakeup;
+} __attribute__((aligned(IVSHM_RING_CACHELINE)));
+
+struct ivshm_ring_ctrl {
+	/** Number of messages published so far. */
+	__u32 head;
+	/** Number of slots, a power of two. */
+	__u32 num_slots;
+	/** Size of a slot in bytes, a multiple of IVSHM_RING_CACHELINE. */
+	__u32 slot_size;
+	/** ID of the consuming peer. */
+	__u32 target;
+} __attribute__((aligned(IVSHM_RING_CACHELINE)));
+
+struct ivshm_ring_slot {
+	/** Length of the message in bytes. */
+	__u32 len;
+	__u32 reserved;
+	__u8 data[];
+};
+
+struct ivshm_ring_section {
+	struct ivshm_ring_cons cons[IVSHM_RING_MAX_PEERS];
+	struct ivshm_ring_ctrl ctrl;
+	__u8 slots[];
+};
+
+/** Local producer state. */
+struct ivshm_ring_tx {
+	struct ivshm_ring_section *own;
+	const struct ivshm_ring_cons *cons;
+	__u32 head;
+	__u32 tail;
+	__u32 mask;
+	__u32 slot_size;
+};
+
+/** Local consumer state. */
+struct ivshm_ring_rx {
+	const struct ivshm_ring_section *peer;
+	struct ivshm_ring_cons *cons;
+	__u32 head;
+	__u32 tail;
+	__u32 mask;
+	__u32 slot_size;
+};
+
+/**
+ * Initialize the transmit ring in the own output section.
+ * @param tx		Producer state.
+ * @param own		Own output section.
+ * @param own_size	Size of the own output section.
+ * @param own_id	Own peer ID.
+ * @param target	Output section of the consuming peer.
+ * @param target_id	ID of the consuming peer.
+ * @param slot_size	Minimal slot size, including struct ivshm_ring_slot.
+ *
+ * @return 0 on success, -1 if the parameters do not fit.
+ */
+static inline int ivshm_ring_tx_init(struct ivshm_ring_tx *tx,
+				     void *own, unsigned long own_size,
+				     unsigned int own_id, const void *target,
+				     unsigned int target_id,
+				     unsigned long slot_size)
+{
+	const struct ivshm_ring_section *target_section = target;
+	struct ivshm_ring_section *section = own;
+	unsigned long num_slots;
+
+	slot_size = (slot_size + IVSHM_RING_CACHELINE - 1) &
+		~(unsigned long)(IVSHM_RING_CACHELINE - 1);
+	if (own_id >= IVSHM_RING_MAX_PEERS ||
+	    target_id >= IVSHM_RING_MAX_PEERS ||
+	    slot_size <= sizeof(struct ivshm_ring_slot) ||
+	    own_size < sizeof(*section) + slot_size)
+		return -1;
+
+	/* round down to a power of two */
+	num_slots = (own_size - sizeof(*section)) / slot_size;
+	while (num_slots & (num_slots - 1))
+		num_slots &= num_slots - 1;
+
+	section->ctrl.num_slots = num_slots;
+	section->ctrl.slot_size = slot_size;
+	section->ctrl.target = target_id;
+	ivshm_ring_store_release(&section->ctrl.head, 0);
+
+	tx->own = section;
+	tx->cons = &target_section->cons[own_id];
+	tx->head = 0;
+	tx->tail = 0;
+	tx->mask = num_slots - 1;
+	tx->slot_size = slot_size;
+
+	return 0;
+}
+
+/**
+ * Reserve the next free slot of the transmit ring.
+ * @param tx		Producer state.
+ *
+ * @return Pointer to the message buffer or NULL if the ring is full.
+ *
+ * @note The buffer holds up to ivshm_ring_max_len() bytes.
+ */
+static inline void *ivshm_ring_reserve(struct ivshm_ring_tx *tx)
+{
+	struct ivshm_ring_slot *slot;
+
+	if (tx->head - tx->tail > tx->mask) {
+		tx->tail = ivshm_ring_load_acquire(&tx->cons->tail);
+		if (tx->head - tx->tail > tx->mask)
+			return (void *)0;
+	}
+
+	slot = (struct ivshm_ring_slot *)
+		&tx->own->slots[(tx->head & tx->mask) * tx->slot_size];
+	return slot->data;
+}
+
+/**
+ * Complete the message in the reserved slot. It becomes visible to the
+ * consumer on the next ivshm_ring_publish().
+ * @param tx		Producer state.
+ * @param len		Length of the message.
+ */
+static inline void ivshm_ring_commit(struct ivshm_ring_tx *tx, __u32 len)
+{
+	struct ivshm_ring_slot *slot = (struct ivshm_ring_slot *)
+		&tx->own->slots[(tx->head & tx->mask) * tx->slot_size];
+
+	slot->len = len;
+	tx->head++;
+}
+
+/**
+ * Make all committed messages visible to the consumer.
+ * @param tx		Producer state.
+ *
+ * @return Non-zero if the consumer has to be woken up via the doorbell.
+ */
+static inline int ivshm_ring_publish(struct ivshm_ring_tx *tx)
+{
+	ivshm_ring_store_release(&tx->own->ctrl.head, tx->head);
+	/* pairs with the fence in ivshm_ring_wait_prepare */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return __atomic_load_n(&tx->cons->wakeup, __ATOMIC_RELAXED);
+}
+
+/**
+ * Initialize the reception from a peer's transmit ring.
+ * @param rx		Consumer state.
+ * @param own		Own output section.
+ * @param own_id	Own peer ID.
+ * @param peer		Output section of the producing peer.
+ * @param peer_size	Size of the producer's output section.
+ * @param peer_id	ID of the producing peer.
+ *
+ * @return 0 on success, -1 if the producer's ring is not set up for us.
+ *
+ * @note The producer's parameters are validated as it may not be trusted.
+ */
+static inline int ivshm_ring_rx_init(struct ivshm_ring_rx *rx, void *own,
+				     unsigned int own_id, const void *peer,
+				     unsigned long peer_size,
+				     unsigned int peer_id)
+{
+	const struct ivshm_ring_section *peer_section = peer;
+	struct ivshm_ring_section *section = own;
+	__u32 num_slots = peer_section->ctrl.num_slots;
+	__u32 slot_size = peer_section->ctrl.slot_size;
+
+	if (own_id >= IVSHM_RING_MAX_PEERS ||
+	    peer_id >= IVSHM_RING_MAX_PEERS ||
+	    peer_section->ctrl.target != own_id ||
+	    num_slots == 0 || (num_slots & (num_slots - 1)) != 0 ||
+	    slot_size <= sizeof(struct ivshm_ring_slot) ||
+	    slot_size % IVSHM_RING_CACHELINE != 0 ||
+	    peer_size < sizeof(*peer_section) ||
+	    (peer_size - sizeof(*peer_section)) / slot_size < num_slots)
+		return -1;
+
+	rx->peer = peer_section;
+	rx->cons = &section->cons[peer_id];
+	rx->head = 0;
+	rx->tail = 0;
+	rx->mask = num_slots - 1;
+	rx->slot_size = slot_size;
+
+	rx->cons->wakeup = 0;
+	ivshm_ring_store_release(&rx->cons->tail, 0);
+
+	return 0;
+}
+
+static inline __u32 ivshm_ring_load_head(struct ivshm_ring_rx *rx)
+{
+	__u32 head = ivshm_ring_load_acquire(&rx->peer->ctrl.head);
+
+	/* do not let a misbehaving producer push us beyond the ring */
+	if (head - rx->tail > rx->mask + 1)
+		head = rx->tail + rx->mask + 1;
+	return head;
+}
+
+/**
+ * Look at the next message from the peer without consuming it.
+ * @param rx		Consumer state.
+ * @param len		Set to the length of the message.
+ *
+ * @return Pointer to the message or NULL if the ring is empty.
+ */
+static inline const void *ivshm_ring_peek(struct ivshm_ring_rx *rx,
+					  __u32 *len)
+{
+	const struct ivshm_ring_slot *slot;
+	__u32 max_len = rx->slot_size - sizeof(*slot);
+
+	if (rx->head == rx->tail) {
+		rx->head = ivshm_ring_load_head(rx);
+		if (rx->head == rx->tail)
+			return (void *)0;
+	}
+
+	slot = (const struct ivshm_ring_slot *)
+		&rx->peer->slots[(rx->tail & rx->mask) * rx->slot_size];
+	*len = slot->len < max_len ? slot->len : max_len;
+	return slot->data;
+}
+
+/**
+ * Hand the slot of the message returned by ivshm_ring_peek() back to the
+ * producer.
+ * @param rx		Consumer state.
+ */
+static inline void ivshm_ring_release(struct ivshm_ring_rx *rx)
+{
+	rx->tail++;
+	ivshm_ring_store_release(&rx->cons->tail, rx->tail);
+}
+
+/**
+ * Request a doorbell interrupt for the next message from the peer.
+ * @param rx		Consumer state.
+ *
+ * @return Non-zero if messages are already pending. The request is withdrawn
+ * then, and the consumer should continue polling instead of waiting.
+ */
+static inline int ivshm_ring_wait_prepare(struct ivshm_ring_rx *rx)
+{
+	__atomic_store_n(&rx->cons->wakeup, 1, __ATOMIC_RELAXED);
+	/* pairs with the fence in ivshm_ring_publish */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	rx->head = ivshm_ring_load_head(rx);
+	if (rx->head == rx->tail)
+		return 0;
+
+	__atomic_store_n(&rx->cons->wakeup, 0, __ATOMIC_RELAXED);
+	return 1;
+}
+
+/**
+ * Withdraw the doorbell request after waking up, suppressing further
+ * interrupts while the consumer polls.
+ * @param rx		Consumer state.
+ */
+static inline void ivshm_ring_wait_finish(struct ivshm_ring_rx *rx)
+{
+	__atomic_store_n(&rx->cons->wakeup, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Return the maximum message length of a ring.
+ * @param slot_size	Slot size of the ring.
+ *
+ * @return Maximum message length in bytes.
+ */
+static inline unsigned long ivshm_ring_max_len(unsigned long slot_size)
+{
+	return slot_size - sizeof(struct ivshm_ring_slot);
+}
+
+#endif /* !_JAILHOUSE_IVSHMEM_RING_H */
@@ -0,0 +1,293 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Throughput and latency benchmark for the ivshmem ring buffers. One peer
+ * runs as initiator (default), the other one as responder ("echo=1" or
+ * tools/demos/ivshmem-ring on Linux). The initiator streams data messages
+ * to measure the throughput and then sends pings that the responder echoes
+ * to measure the round-trip latency.
+ */
+
+#include <inmate.h>
+#include <ivshmem.h>
+
+#define JAILHOUSE_SHMEM_PROTO_UNDEFINED	0x0000
+
+#define BAR_BASE			0xff000000
+
+#if defined(__x86_64__)
+#define DEFAULT_IRQ_BASE	32
+#elif defined(__arm__) || defined(__aarch64__)
+#define DEFAULT_IRQ_BASE	(comm_region->vpci_irq_base + 32)
+#else
+#error Not implemented!
+#endif
+
+#define MSG_DATA		1
+#define MSG_PING		2
+#define MSG_PONG		3
+
+/* empty polls before the responder requests a doorbell interrupt */
+#define POLL_SPINS		1000
+
+struct bench_msg {
+	u32 type;
+	u32 seq;
+};
+
+static struct ivshmem_device dev;
+static struct ivshm_ring_tx tx;
+static struct ivshm_ring_rx rx;
+static volatile unsigned int irq_count;
+static unsigned int irq_base;
+
+static void irq_handler(unsigned int irq)
+{
+	if (irq == irq_base)
+		irq_count++;
+}
+
+static inline void relax(void)
+{
+#ifdef __x86_64__
+	cpu_relax();
+#else
+	asm volatile("yield" : : : "memory");
+#endif
+}
+
+/* 64-bit division without depending on libgcc */
+static u64 div_u64(u64 dividend, u64 divisor)
+{
+	u64 result = 0;
+	int shift = 0;
+
+	if (divisor == 0)
+		return 0;
+
+	while (!(divisor & (1ULL << 63)) && divisor << 1 <= dividend) {
+		divisor <<= 1;
+		shift++;
+	}
+	for (; shift >= 0; shift--, divisor >>= 1)
+		if (dividend >= divisor) {
+			dividend -= divisor;
+			result |= 1ULL << shift;
+		}
+	return result;
+}
+
+static u64 timestamp(void)
+{
+#ifdef __x86_64__
+	return tsc_read_ns();
+#else
+	return timer_get_ticks();
+#endif
+}
+
+static u64 timestamp_to_ns(u64 delta)
+{
+#ifdef __x86_64__
+	return delta;
+#else
+	return div_u64(delta * 1000, timer_get_frequency() / 1000 / 1000);
+#endif
+}
+
+static struct bench_msg *reserve(void)
+{
+	struct bench_msg *msg;
+
+	while (!(msg = ivshm_ring_reserve(&tx)))
+		relax();
+	return msg;
+}
+
+static void run_responder(void)
+{
+	const struct bench_msg *msg;
+	struct bench_msg *reply;
+	unsigned long long received = 0;
+	unsigned int spins = 0, irqs;
+	u32 len;
+
+	printk("IVSHMEM-RING: responding to peer %d\n", tx.own->ctrl.target);
+
+	while (1) {
+		msg = ivshm_ring_peek(&rx, &len);
+		if (!msg) {
+			if (++spins < POLL_SPINS) {
+				relax();
+				continue;
+			}
+			spins = 0;
+
+			irqs = irq_count;
+			if (ivshm_ring_wait_prepare(&rx))
+				continue;
+			while (irq_count == irqs)
+				relax();
+			ivshm_ring_wait_finish(&rx);
+			continue;
+		}
+		spins = 0;
+
+		if (len >= sizeof(*msg) && msg->type == MSG_PING) {
+			reply = reserve();
+			reply->type = MSG_PONG;
+			reply->seq = msg->seq;
+			ivshm_ring_commit(&tx, sizeof(*reply));
+			ivshmem_ring_flush(&dev, &tx, 0);
+		} else if (++received % 1000000 == 0) {
+			printk("IVSHMEM-RING: received %llu messages, "
+			       "%d doorbell IRQs\n", received, irq_count);
+		}
+		ivshm_ring_release(&rx);
+	}
+}
+
+static void run_throughput(unsigned long size, unsigned int batch,
+			   unsigned int count)
+{
+	struct bench_msg *msg;
+	unsigned int n;
+	u64 start, ns;
+
+	start = timestamp();
+	for (n = 0; n < count; n++) {
+		msg = reserve();
+		msg->type = MSG_DATA;
+		msg->seq = n;
+		ivshm_ring_commit(&tx, size);
+		if ((n + 1) % batch == 0)
+			ivshmem_ring_flush(&dev, &tx, 0);
+	}
+	ivshmem_ring_flush(&dev, &tx, 0);
+
+	/* wait for the responder to consume everything */
+	while (ivshm_ring_load_acquire(&tx.cons->tail) != tx.head)
+		relax();
+	ns = timestamp_to_ns(timestamp() - start);
+
+	printk("IVSHMEM-RING: %d messages of %lu bytes, batch %d: "
+	       "%llu msgs/s, %llu MB/s\n", count, size, batch,
+	       div_u64((u64)count * 1000000000ULL, ns),
+	       div_u64((u64)count * size * 1000, ns));
+}
+
+static void run_latency(unsigned int rounds)
+{
+	const struct bench_msg *reply;
+	struct bench_msg *msg;
+	u64 start, ns, min = ~0ULL, max = 0, sum = 0;
+	unsigned int n, irqs = irq_count;
+	u32 len;
+
+	for (n = 0; n < rounds; n++) {
+		start = timestamp();
+
+		msg = reserve();
+		msg->type = MSG_PING;
+		msg->seq = n;
+		ivshm_ring_commit(&tx, sizeof(*msg));
+		ivshmem_ring_flush(&dev, &tx, 0);
+
+		while (1) {
+			reply = ivshm_ring_peek(&rx, &len);
+			if (!reply) {
+				relax();
+				continue;
+			}
+			if (len >= sizeof(*reply) && reply->type == MSG_PONG &&
+			    reply->seq == n)
+				break;
+			ivshm_ring_release(&rx);
+		}
+		ivshm_ring_release(&rx);
+
+		ns = timestamp_to_ns(timestamp() - start);
+		if (ns < min)
+			min = ns;
+		if (ns > max)
+			max = ns;
+		sum += ns;
+	}
+
+	printk("IVSHMEM-RING: round trip over %d rounds: min %llu ns, "
+	       "avg %llu ns, max %llu ns, %d doorbell IRQs received\n",
+	       rounds, min, div_u64(sum, rounds), max, irq_count - irqs);
+}
+
+void inmate_main(void)
+{
+	unsigned int target, batch, count, rounds;
+	unsigned long size;
+	bool echo;
+	int bdf;
+
+	irq_base = cmdline_parse_int("irq_base", DEFAULT_IRQ_BASE);
+	echo = cmdline_parse_bool("echo", false);
+	size = cmdline_parse_int("size", sizeof(struct bench_msg));
+	batch = cmdline_parse_int("batch", 16);
+	count = cmdline_parse_int("count", 1000000);
+	rounds = cmdline_parse_int("rounds", 10000);
+
+	irq_init(irq_handler);
+	pci_init();
+#ifdef __x86_64__
+	tsc_init();
+#endif
+
+	bdf = ivshmem_find_device(JAILHOUSE_SHMEM_PROTO_UNDEFINED, 0);
+	if (bdf < 0) {
+		printk("IVSHMEM-RING: No device found .. nothing to do.\n");
+		stop();
+	}
+	ivshmem_init(&dev, bdf, (void *)BAR_BASE, irq_base, 1);
+
+	target = dev.id + 1 < dev.max_peers ? dev.id + 1 : 0;
+	target = cmdline_parse_int("target", target);
+
+	if (size < sizeof(struct bench_msg))
+		size = sizeof(struct bench_msg);
+	if (batch == 0)
+		batch = 1;
+
+	if (ivshmem_ring_tx_init(&dev, &tx, target,
+				 sizeof(struct ivshm_ring_slot) + size) < 0) {
+		printk("IVSHMEM-RING: output section too small\n");
+		stop();
+	}
+	if (size > ivshm_ring_max_len(tx.slot_size))
+		size = ivshm_ring_max_len(tx.slot_size);
+
+	printk("IVSHMEM-RING: ID %d, target %d, %d slots of %d bytes\n",
+	       dev.id, target, tx.mask + 1, tx.slot_size);
+
+	ivshmem_enable_irqs(&dev, true);
+	enable_irqs();
+	ivshmem_set_state(&dev, dev.id + 1);
+
+	printk("IVSHMEM-RING: waiting for peer %d\n", target);
+	while (ivshmem_get_state(&dev, target) == 0 ||
+	       ivshmem_ring_rx_init(&dev, &rx, target) < 0)
+		delay_us(1000);
+
+	if (echo)
+		run_responder();
+
+	/* give the peer time to attach to our ring */
+	delay_us(100 * 1000);
+
+	run_throughput(size, batch, count);
+	run_latency(rounds);
+
+	printk("IVSHMEM-RING: done\n");
+	stop();
+}
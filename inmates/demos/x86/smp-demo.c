@@ -15,20 +15,26 @@
 #define IPI_VECTOR		40
 
 static volatile bool done;
+static volatile unsigned int ipis;
 static unsigned int main_cpu;
+static bool parallel;
 
 static void ipi_handler(unsigned int irq)
 {
 	if (irq != IPI_VECTOR)
 		return;
 
-	printk("Received IPI on %d\n", cpu_id());
+	ipis++;
+	if (!parallel)
+		printk("Received IPI on %d\n", cpu_id());
 	done = true;
 }
 
 static void secondary_main(void)
 {
-	printk("Hello from CPU %d!\n", cpu_id());
+	/* concurrent output of parallel CPUs would be garbled */
+	if (!parallel)
+		printk("Hello from CPU %d!\n", cpu_id());
 	irq_send_ipi(main_cpu, IPI_VECTOR);
 }
 
@@ -47,6 +53,16 @@ void inmate_main(void)
 
 	asm volatile("sti");
 
+	parallel = cmdline_parse_bool("parallel", false);
+	if (parallel) {
+		printk(" Starting all CPUs in parallel\n");
+		smp_start_cpus(secondary_main);
+		while (ipis < smp_num_cpus - 1)
+			cpu_relax();
+		printk("Received IPIs from %d CPU(s)\n", ipis);
+		return;
+	}
+
 	for (n = 1; n < smp_num_cpus; n++) {
 		printk(" Starting CPU %d\n", smp_cpu_ids[n]);
 		done = false;
@@ -1,7 +1,7 @@
 /*
  * Jailhouse, a Linux-based partitioning hypervisor
  *
- * Copyright (c) Siemens AG, 2018
+ * Copyright (c) Siemens AG, 2018-2026
  *
  * Authors:
  *  Jan Kiszka <jan.kiszka@siemens.com>
@@ -39,13 +39,43 @@
 
 #include <inmate.h>
 
+#ifdef __x86_64__
+/* Only 64-bit x86 inmates can run on multiple CPUs. */
+static unsigned char alloc_locked;
+
+static inline void alloc_lock(void)
+{
+	while (__atomic_test_and_set(&alloc_locked, __ATOMIC_ACQUIRE))
+		cpu_relax();
+}
+
+static inline void alloc_unlock(void)
+{
+	__atomic_clear(&alloc_locked, __ATOMIC_RELEASE);
+}
+#else
+static inline void alloc_lock(void) {}
+static inline void alloc_unlock(void) {}
+#endif
+
 unsigned long heap_pos = (unsigned long)stack_top;
 
+/**
+ * Allocate memory that is never freed again, e.g. for page tables or stacks.
+ * @param size		Size in bytes.
+ * @param align		Alignment, a power of two.
+ *
+ * @return Pointer to the memory.
+ */
 void *alloc(unsigned long size, unsigned long align)
 {
-	unsigned long base = (heap_pos + align - 1) & ~(align - 1);
+	unsigned long base;
 
+	alloc_lock();
+	base = (heap_pos + align - 1) & ~(align - 1);
 	heap_pos = base + size;
+	alloc_unlock();
+
 	return (void *)base;
 }
 
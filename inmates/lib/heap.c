@@ -0,0 +1,421 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <inmate.h>
+
+#define HEAP_MAGIC		0x48454150
+#define HEAP_LARGE		HEAP_CLASSES
+
+/*
+ * Size of the header in front of slabs and large blocks, also the alignment
+ * of large blocks.
+ */
+#define HEAP_HDR_SIZE		64
+
+/* maximum number of objects per class in a CPU cache */
+#define HEAP_CACHE_MAX		32
+
+#define HEAP_LARGE_LISTS	32
+
+#ifdef __x86_64__
+/* Only 64-bit x86 inmates can run on multiple CPUs. */
+#define HEAP_CPUS		SMP_MAX_CPUS
+
+static unsigned char heap_locked;
+
+static inline unsigned int heap_cpu(void)
+{
+	return cpu_id();
+}
+
+static inline void heap_lock(void)
+{
+	while (__atomic_test_and_set(&heap_locked, __ATOMIC_ACQUIRE))
+		cpu_relax();
+}
+
+static inline void heap_unlock(void)
+{
+	__atomic_clear(&heap_locked, __ATOMIC_RELEASE);
+}
+#else
+#define HEAP_CPUS		1
+
+static inline unsigned int heap_cpu(void)
+{
+	return 0;
+}
+
+static inline void heap_lock(void) {}
+static inline void heap_unlock(void) {}
+#endif
+
+struct heap_block {
+	u32 magic;
+	u32 class;
+	/* size in units of HEAP_SLAB_SIZE, large blocks only */
+	unsigned long slabs;
+	struct heap_block *next;
+};
+
+struct heap_object {
+	struct heap_object *next;
+};
+
+struct heap_class {
+	struct heap_object *free;
+	unsigned long carve, carve_end;
+	unsigned long slabs;
+};
+
+struct heap_cache {
+	struct heap_object *free;
+	unsigned long count;
+	unsigned long allocs;
+	unsigned long frees;
+};
+
+static struct heap_class heap_classes[HEAP_CLASSES];
+/* per-CPU caches, allocated on the first use of the heap by a CPU */
+static struct heap_cache *heap_caches[HEAP_CPUS];
+static struct heap_block *large_free[HEAP_LARGE_LISTS], *huge_free;
+static unsigned long large_slabs, large_in_use, large_allocs, large_frees;
+
+static struct heap_cache *cpu_cache(unsigned int class)
+{
+	struct heap_cache **caches = &heap_caches[heap_cpu()];
+
+	if (!*caches)
+		*caches = zalloc(HEAP_CLASSES * sizeof(struct heap_cache),
+				 sizeof(long));
+	return &(*caches)[class];
+}
+
+static unsigned int size_to_class(unsigned long size)
+{
+	if (size <= 1UL << HEAP_MIN_SHIFT)
+		return 0;
+	return sizeof(long) * 8 - __builtin_clzl(size - 1) - HEAP_MIN_SHIFT;
+}
+
+static struct heap_block *new_block(unsigned int class, unsigned long slabs)
+{
+	struct heap_block *block;
+
+	block = alloc(slabs * HEAP_SLAB_SIZE, HEAP_SLAB_SIZE);
+	block->magic = HEAP_MAGIC;
+	block->class = class;
+	block->slabs = slabs;
+
+	return block;
+}
+
+static void *class_alloc(unsigned int class)
+{
+	struct heap_class *hc = &heap_classes[class];
+	unsigned long size = HEAP_CLASS_SIZE(class);
+	struct heap_object *obj = hc->free;
+	struct heap_block *slab;
+
+	if (obj) {
+		hc->free = obj->next;
+		return obj;
+	}
+
+	if (hc->carve == hc->carve_end) {
+		slab = new_block(class, 1);
+		/* keep objects naturally aligned behind the header */
+		hc->carve = (unsigned long)slab +
+			(size > HEAP_HDR_SIZE ? size : HEAP_HDR_SIZE);
+		hc->carve_end = (unsigned long)slab + HEAP_SLAB_SIZE;
+		hc->slabs++;
+	}
+
+	obj = (struct heap_object *)hc->carve;
+	hc->carve += size;
+	return obj;
+}
+
+static void *large_alloc(unsigned long size)
+{
+	unsigned long slabs = (size + HEAP_HDR_SIZE + HEAP_SLAB_SIZE - 1) /
+		HEAP_SLAB_SIZE;
+	struct heap_block *block, **prev;
+
+	heap_lock();
+	if (slabs <= HEAP_LARGE_LISTS) {
+		block = large_free[slabs - 1];
+		if (block)
+			large_free[slabs - 1] = block->next;
+	} else {
+		/* not bounded, but only used for blocks above 512K */
+		for (prev = &huge_free, block = huge_free; block;
+		     prev = &block->next, block = block->next)
+			if (block->slabs == slabs) {
+				*prev = block->next;
+				break;
+			}
+	}
+	if (!block) {
+		block = new_block(HEAP_LARGE, slabs);
+		large_slabs += slabs;
+	}
+	large_in_use += slabs;
+	large_allocs++;
+	heap_unlock();
+
+	return (void *)block + HEAP_HDR_SIZE;
+}
+
+/**
+ * Allocate memory from the heap.
+ * @param size		Size in bytes.
+ *
+ * @return Pointer to the memory or NULL if size is 0. Objects of up to
+ * HEAP_MAX_OBJECT bytes are aligned to their size class (at least 16 bytes),
+ * larger blocks to 64 bytes.
+ *
+ * Requests of up to HEAP_MAX_OBJECT bytes are served from size-class slabs
+ * via a per-CPU cache, larger ones from free lists of blocks that are
+ * multiples of HEAP_SLAB_SIZE. Both paths take constant time, except for
+ * recycling blocks above HEAP_LARGE_LISTS slabs. Memory returned to the heap
+ * is only reused for allocations of the same class.
+ *
+ * @note Must not be called from interrupt handlers.
+ */
+void *malloc(unsigned long size)
+{
+	struct heap_cache *cache;
+	struct heap_object *obj;
+	unsigned int class;
+
+	if (size == 0)
+		return NULL;
+	if (size > HEAP_MAX_OBJECT)
+		return large_alloc(size);
+
+	class = size_to_class(size);
+	cache = cpu_cache(class);
+	obj = cache->free;
+	if (obj) {
+		cache->free = obj->next;
+		cache->count--;
+	} else {
+		heap_lock();
+		obj = class_alloc(class);
+		heap_unlock();
+	}
+	cache->allocs++;
+
+	return obj;
+}
+
+/**
+ * Return memory to the heap.
+ * @param ptr		Pointer returned by malloc(), or NULL.
+ */
+void free(void *ptr)
+{
+	struct heap_block *block = (struct heap_block *)
+		((unsigned long)ptr & ~(HEAP_SLAB_SIZE - 1));
+	struct heap_object *obj = ptr;
+	struct heap_cache *cache;
+	struct heap_class *hc;
+
+	if (!ptr)
+		return;
+
+	if (block->magic != HEAP_MAGIC) {
+		printk("FATAL: free() of invalid pointer %p\n", ptr);
+		stop();
+	}
+
+	if (block->class == HEAP_LARGE) {
+		heap_lock();
+		if (block->slabs <= HEAP_LARGE_LISTS) {
+			block->next = large_free[block->slabs - 1];
+			large_free[block->slabs - 1] = block;
+		} else {
+			block->next = huge_free;
+			huge_free = block;
+		}
+		large_in_use -= block->slabs;
+		large_frees++;
+		heap_unlock();
+		return;
+	}
+
+	cache = cpu_cache(block->class);
+	if (cache->count < HEAP_CACHE_MAX) {
+		obj->next = cache->free;
+		cache->free = obj;
+		cache->count++;
+	} else {
+		hc = &heap_classes[block->class];
+		heap_lock();
+		obj->next = hc->free;
+		hc->free = obj;
+		heap_unlock();
+	}
+	cache->frees++;
+}
+
+/**
+ * Collect heap statistics.
+ * @param stats		Statistics structure to fill.
+ *
+ * @note Counters of other CPUs may be updated concurrently, so the result is
+ * only a snapshot.
+ */
+void heap_get_stats(struct heap_stats *stats)
+{
+	struct heap_cache *cache;
+	unsigned int class, cpu;
+
+	memset(stats, 0, sizeof(*stats));
+
+	heap_lock();
+	for (class = 0; class < HEAP_CLASSES; class++) {
+		stats->classes[class].size = HEAP_CLASS_SIZE(class);
+		stats->classes[class].slabs = heap_classes[class].slabs;
+		for (cpu = 0; cpu < HEAP_CPUS; cpu++) {
+			if (!heap_caches[cpu])
+				continue;
+			cache = &heap_caches[cpu][class];
+			stats->classes[class].allocs += cache->allocs;
+			stats->classes[class].frees += cache->frees;
+			stats->classes[class].cached += cache->count;
+		}
+		stats->slab_bytes += heap_classes[class].slabs * HEAP_SLAB_SIZE;
+	}
+	stats->large_bytes = large_slabs * HEAP_SLAB_SIZE;
+	stats->large_in_use = large_in_use * HEAP_SLAB_SIZE;
+	stats->large_allocs = large_allocs;
+	stats->large_frees = large_frees;
+	stats->heap_end = heap_pos;
+	heap_unlock();
+}
+
+void heap_print_stats(void)
+{
+	struct heap_stats stats;
+	unsigned int class;
+
+	heap_get_stats(&stats);
+
+	printk("Heap: %lu bytes in slabs, %lu bytes in large blocks "
+	       "(%lu in use), end at %p\n", stats.slab_bytes,
+	       stats.large_bytes, stats.large_in_use, (void *)stats.heap_end);
+	for (class = 0; class < HEAP_CLASSES; class++)
+		printk("  %4lu bytes: %lu slabs, %lu allocs, %lu frees, "
+		       "%lu cached\n", stats.classes[class].size,
+		       stats.classes[class].slabs,
+		       stats.classes[class].allocs,
+		       stats.classes[class].frees,
+		       stats.classes[class].cached);
+	printk("  large: %lu allocs, %lu frees\n", stats.large_allocs,
+	       stats.large_frees);
+}
+
+/**
+ * Set up a pool of fixed-size objects, e.g. for DMA descriptors.
+ * @param pool		Pool to initialize.
+ * @param obj_size	Size of an object in bytes.
+ * @param align		Alignment of the objects, a power of two.
+ * @param count		Number of objects.
+ *
+ * The objects are allocated in one contiguous, never freed region that
+ * starts at pool->base, so it can be remapped, e.g. uncached, as a whole.
+ * pool_alloc() and pool_free() take constant time.
+ */
+void pool_init(struct pool *pool, unsigned long obj_size,
+	       unsigned long align, unsigned int count)
+{
+	struct heap_object *obj;
+	unsigned int n;
+
+	if (align < sizeof(void *))
+		align = sizeof(void *);
+	obj_size = (obj_size + align - 1) & ~(align - 1);
+
+	pool->base = alloc(obj_size * count, align);
+	pool->obj_size = obj_size;
+	pool->count = count;
+	pool->in_use = 0;
+	pool->free = NULL;
+
+	for (n = count; n > 0; n--) {
+		obj = pool->base + (n - 1) * obj_size;
+		obj->next = pool->free;
+		pool->free = obj;
+	}
+}
+
+/**
+ * Take an object from a pool.
+ * @param pool		Pool to allocate from.
+ *
+ * @return Pointer to the object or NULL if the pool is exhausted.
+ */
+void *pool_alloc(struct pool *pool)
+{
+	struct heap_object *obj;
+
+	heap_lock();
+	obj = pool->free;
+	if (obj) {
+		pool->free = obj->next;
+		pool->in_use++;
+	}
+	heap_unlock();
+
+	return obj;
+}
+
+/**
+ * Return an object to its pool.
+ * @param pool		Pool the object was allocated from.
+ * @param ptr		Pointer to the object.
+ */
+void pool_free(struct pool *pool, void *ptr)
+{
+	struct heap_object *obj = ptr;
+
+	heap_lock();
+	obj->next = pool->free;
+	pool->free = obj;
+	pool->in_use--;
+	heap_unlock();
+}
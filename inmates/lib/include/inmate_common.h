@@ -105,6 +105,47 @@ extern unsigned long heap_pos;
 void *alloc(unsigned long size, unsigned long align);
 void *zalloc(unsigned long size, unsigned long align);
 
+#define HEAP_SLAB_SIZE		(16 * 1024UL)
+#define HEAP_MIN_SHIFT		4
+#define HEAP_CLASSES		8
+#define HEAP_CLASS_SIZE(class)	(1UL << (HEAP_MIN_SHIFT + (class)))
+#define HEAP_MAX_OBJECT		HEAP_CLASS_SIZE(HEAP_CLASSES - 1)
+
+struct heap_stats {
+	struct {
+		unsigned long size;
+		unsigned long slabs;
+		unsigned long allocs;
+		unsigned long frees;
+		/* freed objects held in per-CPU caches */
+		unsigned long cached;
+	} classes[HEAP_CLASSES];
+	unsigned long slab_bytes;
+	unsigned long large_bytes;
+	unsigned long large_in_use;
+	unsigned long large_allocs;
+	unsigned long large_frees;
+	unsigned long heap_end;
+};
+
+void *malloc(unsigned long size);
+void free(void *ptr);
+void heap_get_stats(struct heap_stats *stats);
+void heap_print_stats(void);
+
+struct pool {
+	void *base;
+	void *free;
+	unsigned long obj_size;
+	unsigned int count;
+	unsigned int in_use;
+};
+
+void pool_init(struct pool *pool, unsigned long obj_size,
+	       unsigned long align, unsigned int count);
+void *pool_alloc(struct pool *pool);
+void pool_free(struct pool *pool, void *ptr);
+
 void *memset(void *s, int c, unsigned long n);
 void *memcpy(void *d, const void *s, unsigned long n);
 int memcmp(const void *s1, const void *s2, unsigned long n);
@@ -0,0 +1,103 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <jailhouse/ivshmem-ring.h>
+
+#define IVSHMEM_VENDOR_ID		0x110a
+#define IVSHMEM_DEVICE_ID		0x4106
+
+struct ivshmem_regs {
+	u32 id;
+	u32 max_peers;
+	u32 int_control;
+	u32 doorbell;
+	u32 state;
+};
+
+struct ivshmem_device {
+	u16 bdf;
+	struct ivshmem_regs *registers;
+	u32 *msix_table;
+	volatile u32 *state_table;
+	u32 state_table_sz;
+	void *rw_section;
+	u64 rw_section_sz;
+	void *out_sections;
+	u64 out_section_sz;
+	u32 id;
+	u32 max_peers;
+	int msix_cap;
+	unsigned int vectors;
+};
+
+int ivshmem_find_device(u16 protocol, u16 start_bdf);
+void ivshmem_init(struct ivshmem_device *dev, u16 bdf, void *bar_base,
+		  unsigned int irq_base, unsigned int max_vectors);
+
+static inline void *ivshmem_out_section(struct ivshmem_device *dev,
+					unsigned int peer)
+{
+	return dev->out_sections + peer * dev->out_section_sz;
+}
+
+static inline void ivshmem_set_state(struct ivshmem_device *dev, u32 state)
+{
+	mmio_write32(&dev->registers->state, state);
+}
+
+static inline u32 ivshmem_get_state(struct ivshmem_device *dev,
+				    unsigned int peer)
+{
+	return dev->state_table[peer];
+}
+
+static inline void ivshmem_enable_irqs(struct ivshmem_device *dev,
+				       bool enable)
+{
+	mmio_write32(&dev->registers->int_control, enable);
+}
+
+static inline void ivshmem_doorbell(struct ivshmem_device *dev,
+				    unsigned int peer, unsigned int vector)
+{
+	mmio_write32(&dev->registers->doorbell, vector | (peer << 16));
+}
+
+int ivshmem_ring_tx_init(struct ivshmem_device *dev, struct ivshm_ring_tx *tx,
+			 unsigned int target, unsigned long slot_size);
+int ivshmem_ring_rx_init(struct ivshmem_device *dev, struct ivshm_ring_rx *rx,
+			 unsigned int sender);
+void ivshmem_ring_flush(struct ivshmem_device *dev, struct ivshm_ring_tx *tx,
+			unsigned int vector);
@@ -0,0 +1,195 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Alternatively, you can use or redistribute this file under the following
+ * BSD license:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <inmate.h>
+#include <ivshmem.h>
+
+#define IVSHMEM_CFG_STATE_TAB_SZ	0x04
+#define IVSHMEM_CFG_RW_SECTION_SZ	0x08
+#define IVSHMEM_CFG_OUT_SECTION_SZ	0x10
+#define IVSHMEM_CFG_ADDRESS		0x18
+
+static u64 pci_cfg_read64(u16 bdf, unsigned int addr)
+{
+	return pci_read_config(bdf, addr, 4) |
+		((u64)pci_read_config(bdf, addr + 4, 4) << 32);
+}
+
+/**
+ * Find an ivshmem device that uses the given protocol.
+ * @param protocol	Protocol type as found in the class code register.
+ * @param start_bdf	BDF to start the search at.
+ *
+ * @return BDF of the device or -1 if none was found.
+ */
+int ivshmem_find_device(u16 protocol, u16 start_bdf)
+{
+	int bdf = start_bdf;
+
+	while (1) {
+		bdf = pci_find_device(IVSHMEM_VENDOR_ID, IVSHMEM_DEVICE_ID,
+				      bdf);
+		if (bdf < 0)
+			return -1;
+		if (pci_read_config(bdf, 0x8, 4) ==
+		    (PCI_DEV_CLASS_OTHER << 24 | protocol << 8))
+			return bdf;
+		bdf++;
+	}
+}
+
+/**
+ * Set up an ivshmem device and map its registers and shared memory.
+ * @param dev		Device to initialize.
+ * @param bdf		BDF of the device.
+ * @param bar_base	Address to map BAR 0 (registers) and BAR 1 (MSI-X
+ * 			table) to, two pages in total.
+ * @param irq_base	First IRQ of the device.
+ * @param max_vectors	Maximum number of MSI-X vectors to use.
+ *
+ * @note Interrupts still have to be enabled via ivshmem_enable_irqs().
+ */
+void ivshmem_init(struct ivshmem_device *dev, u16 bdf, void *bar_base,
+		  unsigned int irq_base, unsigned int max_vectors)
+{
+	unsigned long baseaddr, addr;
+	int vndr_cap;
+	unsigned int n;
+
+	dev->bdf = bdf;
+
+	vndr_cap = pci_find_cap(bdf, PCI_CAP_VENDOR);
+	if (vndr_cap < 0) {
+		printk("IVSHMEM ERROR: missing vendor capability\n");
+		stop();
+	}
+
+	dev->registers = bar_base;
+	pci_write_config(bdf, PCI_CFG_BAR, (unsigned long)dev->registers, 4);
+
+	dev->msix_table = bar_base + PAGE_SIZE;
+	pci_write_config(bdf, PCI_CFG_BAR + 4, (unsigned long)dev->msix_table,
+			 4);
+
+	pci_write_config(bdf, PCI_CFG_COMMAND, (PCI_CMD_MEM | PCI_CMD_MASTER),
+			 2);
+
+	map_range(bar_base, 2 * PAGE_SIZE, MAP_UNCACHED);
+
+	dev->id = mmio_read32(&dev->registers->id);
+	dev->max_peers = mmio_read32(&dev->registers->max_peers);
+
+	dev->state_table_sz =
+		pci_read_config(bdf, vndr_cap + IVSHMEM_CFG_STATE_TAB_SZ, 4);
+	dev->rw_section_sz =
+		pci_cfg_read64(bdf, vndr_cap + IVSHMEM_CFG_RW_SECTION_SZ);
+	dev->out_section_sz =
+		pci_cfg_read64(bdf, vndr_cap + IVSHMEM_CFG_OUT_SECTION_SZ);
+	baseaddr = pci_cfg_read64(bdf, vndr_cap + IVSHMEM_CFG_ADDRESS);
+
+	addr = baseaddr;
+	dev->state_table = (u32 *)addr;
+
+	addr += dev->state_table_sz;
+	dev->rw_section = (void *)addr;
+
+	addr += dev->rw_section_sz;
+	dev->out_sections = (void *)addr;
+
+	map_range((void *)baseaddr, dev->state_table_sz + dev->rw_section_sz +
+		  dev->max_peers * dev->out_section_sz, MAP_CACHED);
+
+	dev->msix_cap = pci_find_cap(bdf, PCI_CAP_MSIX);
+	dev->vectors = dev->msix_cap > 0 ? max_vectors : 1;
+	for (n = 0; n < dev->vectors; n++) {
+		if (dev->msix_cap > 0)
+			pci_msix_set_vector(bdf, irq_base + n, n);
+		irq_enable(irq_base + n);
+	}
+}
+
+/**
+ * Set up the transmit ring of the device in the own output section.
+ * @param dev		ivshmem device.
+ * @param tx		Producer state.
+ * @param target	ID of the receiving peer.
+ * @param slot_size	Minimal slot size, see ivshm_ring_tx_init().
+ *
+ * @return 0 on success, -1 on invalid parameters.
+ */
+int ivshmem_ring_tx_init(struct ivshmem_device *dev, struct ivshm_ring_tx *tx,
+			 unsigned int target, unsigned long slot_size)
+{
+	if (target >= dev->max_peers)
+		return -1;
+
+	return ivshm_ring_tx_init(tx, ivshmem_out_section(dev, dev->id),
+				  dev->out_section_sz, dev->id,
+				  ivshmem_out_section(dev, target), target,
+				  slot_size);
+}
+
+/**
+ * Attach to the transmit ring of a peer.
+ * @param dev		ivshmem device.
+ * @param rx		Consumer state.
+ * @param sender	ID of the sending peer.
+ *
+ * @return 0 on success, -1 if the peer has no valid ring for us.
+ */
+int ivshmem_ring_rx_init(struct ivshmem_device *dev, struct ivshm_ring_rx *rx,
+			 unsigned int sender)
+{
+	if (sender >= dev->max_peers)
+		return -1;
+
+	return ivshm_ring_rx_init(rx, ivshmem_out_section(dev, dev->id),
+				  dev->id, ivshmem_out_section(dev, sender),
+				  dev->out_section_sz, sender);
+}
+
+/**
+ * Publish all committed messages and ring the doorbell of the receiver if
+ * it waits for them.
+ * @param dev		ivshmem device.
+ * @param tx		Producer state.
+ * @param vector	Interrupt vector to trigger at the receiver.
+ */
+void ivshmem_ring_flush(struct ivshmem_device *dev, struct ivshm_ring_tx *tx,
+			unsigned int vector)
+{
+	if (ivshm_ring_publish(tx))
+		ivshmem_doorbell(dev, tx->own->ctrl.target, vector);
+}
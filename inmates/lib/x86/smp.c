@@ -38,10 +38,18 @@
 
 #include <inmate.h>
 
-#define APIC_DM_INIT	(5 << 8)
-#define APIC_DM_SIPI	(6 << 8)
+#define APIC_DM_INIT		(5 << 8)
+#define APIC_DM_SIPI		(6 << 8)
+#define APIC_SH_ALLOTHER	(3 << 18)
 
 extern void (* volatile ap_entry)(void);
+extern void (* volatile parallel_entry)(void);
+
+/* stacks for smp_start_cpus, indexed by initial APIC ID */
+void *parallel_stacks[256];
+
+static void (* volatile parallel_main)(void);
+static volatile u32 cpus_arrived;
 
 void smp_wait_for_all_cpus(void)
 {
@@ -49,19 +57,61 @@ void smp_wait_for_all_cpus(void)
 		cpu_relax();
 }
 
-void smp_start_cpu(unsigned int cpu_id, void (*entry)(void))
+/*
+ * The hypervisor only completes an INIT request after the target CPUs
+ * accepted it. So there is no need to wait before sending the SIPI, and a
+ * single SIPI is sufficient.
+ */
+static void send_init_sipi(u64 icr)
 {
-	u64 base_val = ((u64)cpu_id << 32) | APIC_LVL_ASSERT;
+	write_msr(X2APIC_ICR, icr | APIC_LVL_ASSERT | APIC_DM_INIT);
+	write_msr(X2APIC_ICR, icr | APIC_LVL_ASSERT | APIC_DM_SIPI);
+}
 
+void smp_start_cpu(unsigned int cpu_id, void (*entry)(void))
+{
 	ap_entry = entry;
 	stack = zalloc(PAGE_SIZE, PAGE_SIZE) + PAGE_SIZE;
 
-	write_msr(X2APIC_ICR, base_val | APIC_DM_INIT);
-	delay_us(10000);
-	write_msr(X2APIC_ICR, base_val | APIC_DM_SIPI);
-	delay_us(200);
-	write_msr(X2APIC_ICR, base_val | APIC_DM_SIPI);
+	send_init_sipi((u64)cpu_id << 32);
 
 	while (ap_entry && stack)
 		cpu_relax();
 }
+
+static void parallel_start(void)
+{
+	__atomic_fetch_add(&cpus_arrived, 1, __ATOMIC_RELEASE);
+	parallel_main();
+}
+
+/**
+ * Start all other CPUs of the cell at once.
+ * @param entry		Function the CPUs will run.
+ *
+ * The CPUs get a stack of their own and are (re-)started via a broadcast
+ * INIT/SIPI. The function returns after all of them entered @c entry.
+ *
+ * @note smp_wait_for_all_cpus() has to be called before.
+ */
+void smp_start_cpus(void (*entry)(void))
+{
+	unsigned int n, self = cpu_id();
+
+	for (n = 0; n < smp_num_cpus; n++)
+		if (smp_cpu_ids[n] != self)
+			parallel_stacks[smp_cpu_ids[n]] =
+				zalloc(PAGE_SIZE, PAGE_SIZE) + PAGE_SIZE;
+
+	cpus_arrived = 0;
+	parallel_main = entry;
+	parallel_entry = parallel_start;
+
+	send_init_sipi(APIC_SH_ALLOTHER);
+
+	while (__atomic_load_n(&cpus_arrived, __ATOMIC_ACQUIRE) <
+	       smp_num_cpus - 1)
+		cpu_relax();
+
+	parallel_entry = NULL;
+}
@@ -0,0 +1,152 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <inmate.h>
+#include <test.h>
+
+/*
+ * heap-test exercises malloc/free, pools and the heap statistics. Load it into
+ * smp-demo.cell to also cover objects that are freed on another CPU than the
+ * one that allocated them.
+ */
+
+#define OBJECTS		64
+#define POOL_OBJECTS	8
+
+static void *objects[OBJECTS];
+static volatile bool done;
+
+static bool aligned(void *ptr, unsigned long align)
+{
+	return ((unsigned long)ptr & (align - 1)) == 0;
+}
+
+/*
+ * Runs on a secondary CPU: release what the primary CPU allocated and serve
+ * new requests from the slabs the primary CPU carved.
+ */
+static void secondary_main(void)
+{
+	unsigned int n;
+
+	for (n = 0; n < OBJECTS; n++)
+		free(objects[n]);
+	for (n = 0; n < OBJECTS; n++)
+		objects[n] = malloc(64);
+
+	done = true;
+}
+
+static void test_cross_cpu(void)
+{
+	struct heap_stats before, after;
+	unsigned int n;
+	bool valid;
+
+	smp_wait_for_all_cpus();
+	if (smp_num_cpus < 2) {
+		printk("Only one CPU, skipping cross-CPU test\n");
+		return;
+	}
+
+	for (n = 0; n < OBJECTS; n++)
+		objects[n] = malloc(64);
+
+	heap_get_stats(&before);
+	smp_start_cpu(smp_cpu_ids[1], secondary_main);
+	while (!done)
+		cpu_relax();
+	heap_get_stats(&after);
+
+	/* all objects were recycled, no new slab was needed */
+	EXPECT_EQUAL(after.classes[2].slabs, before.classes[2].slabs);
+	EXPECT_EQUAL(after.classes[2].frees - before.classes[2].frees, OBJECTS);
+
+	valid = true;
+	for (n = 0; n < OBJECTS; n++)
+		if (!objects[n] || !aligned(objects[n], 64))
+			valid = false;
+	EXPECT_EQUAL(valid, true);
+
+	/* and back to the primary CPU */
+	for (n = 0; n < OBJECTS; n++)
+		free(objects[n]);
+}
+
+void inmate_main(void)
+{
+	void *obj, *again, *large, *pool_objs[POOL_OBJECTS];
+	struct heap_stats stats;
+	struct pool pool;
+	unsigned int n;
+
+	printk("\n");
+
+	/* --- Size classes --- */
+
+	EXPECT_EQUAL((unsigned long)malloc(0), 0);
+
+	obj = malloc(1);
+	EXPECT_EQUAL(aligned(obj, 16), true);
+	memset(obj, 0xaa, 16);
+	free(obj);
+	again = malloc(16);
+	EXPECT_EQUAL((unsigned long)again, (unsigned long)obj);
+	free(again);
+
+	for (n = 0; n < HEAP_CLASSES; n++) {
+		obj = malloc(HEAP_CLASS_SIZE(n));
+		EXPECT_EQUAL(aligned(obj, HEAP_CLASS_SIZE(n)), true);
+		memset(obj, 0x55, HEAP_CLASS_SIZE(n));
+		free(obj);
+		/* freed objects are only reused within their class */
+		again = malloc(HEAP_CLASS_SIZE(n) - 1);
+		EXPECT_EQUAL((unsigned long)again, (unsigned long)obj);
+		free(again);
+	}
+
+	/* --- Large blocks --- */
+
+	large = malloc(3 * HEAP_SLAB_SIZE);
+	EXPECT_EQUAL(aligned(large, 64), true);
+	memset(large, 0, 3 * HEAP_SLAB_SIZE);
+	free(large);
+	obj = malloc(3 * HEAP_SLAB_SIZE);
+	EXPECT_EQUAL((unsigned long)obj, (unsigned long)large);
+
+	heap_get_stats(&stats);
+	EXPECT_EQUAL(stats.large_allocs, 2);
+	EXPECT_EQUAL(stats.large_frees, 1);
+	EXPECT_EQUAL(stats.large_bytes, 4 * HEAP_SLAB_SIZE);
+	free(obj);
+
+	/* --- Pools --- */
+
+	pool_init(&pool, 24, 32, POOL_OBJECTS);
+	for (n = 0; n < POOL_OBJECTS; n++) {
+		pool_objs[n] = pool_alloc(&pool);
+		EXPECT_EQUAL(aligned(pool_objs[n], 32), true);
+		EXPECT_EQUAL((unsigned long)pool_objs[n],
+			     (unsigned long)pool.base + n * 32);
+	}
+	EXPECT_EQUAL((unsigned long)pool_alloc(&pool), 0);
+	EXPECT_EQUAL(pool.in_use, POOL_OBJECTS);
+
+	pool_free(&pool, pool_objs[3]);
+	EXPECT_EQUAL((unsigned long)pool_alloc(&pool),
+		     (unsigned long)pool_objs[3]);
+
+	/* --- Multiple CPUs --- */
+
+	test_cross_cpu();
+
+	heap_print_stats();
+
+	printk("Heap test %s\n", all_passed ? "passed" : "FAILED");
+}
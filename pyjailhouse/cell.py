@@ -22,6 +22,8 @@ class JailhouseCell:
 
     JAILHOUSE_CELL_ID_UNUSED = -1
 
+    JAILHOUSE_IMAGE_SOURCE_FD = 0x0001
+
     def __init__(self, config):
         self.name = config.name.encode()
 
@@ -43,6 +45,21 @@ class JailhouseCell:
                            1, ctypes.addressof(cbuf), len(image), address)
         fcntl.ioctl(self.dev, self.JAILHOUSE_CELL_LOAD, load)
 
+    def load_from_file(self, file, images):
+        """Load images from a file in one go.
+
+        The driver reads the images directly from the file. images is a list
+        of (file offset, size, target address) tuples.
+        """
+        load = struct.pack('i4x32sI4x',
+                           JailhouseCell.JAILHOUSE_CELL_ID_UNUSED, self.name,
+                           len(images))
+        for (offset, size, address) in images:
+            load += struct.pack('QQQIi', offset, size, address,
+                                JailhouseCell.JAILHOUSE_IMAGE_SOURCE_FD,
+                                file.fileno())
+        fcntl.ioctl(self.dev, self.JAILHOUSE_CELL_LOAD, load)
+
     def start(self):
         start = struct.pack('i4x32s', JailhouseCell.JAILHOUSE_CELL_ID_UNUSED,
                             self.name)
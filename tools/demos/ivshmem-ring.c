@@ -0,0 +1,212 @@
+/*
+ * Jailhouse, a Linux-based partitioning hypervisor
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ *
+ * Responder for the ivshmem-ring-bench inmate, using the ring buffers on
+ * top of the uio_ivshmem driver. Pings are echoed, data messages counted.
+ */
+
+#include <errno.h>
+#include <error.h>
+#include <libgen.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/fcntl.h>
+#include <linux/types.h>
+
+#include <jailhouse/ivshmem-ring.h>
+
+#define MSG_DATA		1
+#define MSG_PING		2
+#define MSG_PONG		3
+
+/* empty polls before waiting for a doorbell interrupt */
+#define POLL_SPINS		100000
+
+struct ivshm_regs {
+	uint32_t id;
+	uint32_t max_peers;
+	uint32_t int_control;
+	uint32_t doorbell;
+	uint32_t state;
+};
+
+struct bench_msg {
+	uint32_t type;
+	uint32_t seq;
+};
+
+static inline uint32_t mmio_read32(void *address)
+{
+	return *(volatile uint32_t *)address;
+}
+
+static inline void mmio_write32(void *address, uint32_t value)
+{
+	*(volatile uint32_t *)address = value;
+}
+
+static size_t uio_read_mem_size(char *uio_devname, int idx)
+{
+	char sysfs_path[64];
+	char output[20] = "";
+	size_t size;
+	int fd, ret;
+
+	snprintf(sysfs_path, sizeof(sysfs_path),
+		 "/sys/class/uio/%s/maps/map%d/size",
+		 uio_devname, idx);
+	fd = open(sysfs_path, O_RDONLY);
+	if (fd < 0)
+		error(1, errno, "open(sysfs)");
+	ret = read(fd, output, sizeof(output));
+	if (ret < 0)
+		error(1, errno, "read(sysfs)");
+	close(fd);
+	if (sscanf(output, "0x%zx", &size) != 1)
+		error(1, EINVAL, "sscanf(sysfs)");
+	return size;
+}
+
+static void *uio_map(int fd, char *uio_devname, int idx, int prot)
+{
+	void *map;
+
+	map = mmap(NULL, uio_read_mem_size(uio_devname, idx), prot,
+		   MAP_SHARED, fd, idx * getpagesize());
+	if (map == MAP_FAILED)
+		error(1, errno, "mmap(map%d)", idx);
+	return map;
+}
+
+static void wait_for_doorbell(int fd, struct ivshm_regs *regs)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint32_t int_count;
+	int ret;
+
+	ret = poll(&pfd, 1, -1);
+	if (ret < 0)
+		error(1, errno, "poll");
+
+	ret = read(fd, &int_count, sizeof(int_count));
+	if (ret != sizeof(int_count))
+		error(1, errno, "read(uio)");
+
+	mmio_write32(&regs->int_control, 1);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t target = INT_MAX, id, max_peers, len;
+	unsigned long long received = 0, irqs = 0;
+	const struct bench_msg *msg;
+	struct bench_msg *reply;
+	struct ivshm_ring_tx tx;
+	struct ivshm_ring_rx rx;
+	char *path = strdup("/dev/uio0");
+	size_t out_size, slot_size = 64;
+	volatile uint32_t *state;
+	struct ivshm_regs *regs;
+	char *uio_devname, *in;
+	unsigned int spins = 0;
+	void *out;
+	int fd, i;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp("-t", argv[i]) || !strcmp("--target", argv[i])) {
+			i++;
+			target = atoi(argv[i]);
+			continue;
+		} else if (!strcmp("-d", argv[i]) || !strcmp("--device", argv[i])) {
+			i++;
+			path = argv[i];
+			continue;
+		} else if (!strcmp("-s", argv[i]) || !strcmp("--slot-size", argv[i])) {
+			i++;
+			slot_size = atoi(argv[i]);
+			continue;
+		} else {
+			printf("Invalid argument '%s'\n", argv[i]);
+			error(1, EINVAL, "Usage: ivshmem-ring [-d DEV] "
+			      "[-t TARGET] [-s SLOT_SIZE]");
+		}
+	}
+
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		error(1, errno, "open(%s)", path);
+	uio_devname = basename(path);
+
+	regs = uio_map(fd, uio_devname, 0, PROT_READ | PROT_WRITE);
+	id = mmio_read32(&regs->id);
+	max_peers = mmio_read32(&regs->max_peers);
+
+	if (target == INT_MAX)
+		target = (id + 1) % max_peers;
+	if (target >= max_peers || target == id)
+		error(1, EINVAL, "invalid peer number");
+
+	state = uio_map(fd, uio_devname, 1, PROT_READ);
+	in = uio_map(fd, uio_devname, 3, PROT_READ);
+	out = uio_map(fd, uio_devname, 4, PROT_READ | PROT_WRITE);
+	out_size = uio_read_mem_size(uio_devname, 4);
+
+	if (ivshm_ring_tx_init(&tx, out, out_size, id, in + target * out_size,
+			       target, slot_size) < 0)
+		error(1, EINVAL, "output section too small");
+
+	printf("ID %d, target %d, %d slots of %d bytes\n", id, target,
+	       tx.mask + 1, tx.slot_size);
+
+	mmio_write32(&regs->int_control, 1);
+	mmio_write32(&regs->state, id + 1);
+
+	printf("Waiting for peer %d\n", target);
+	while (state[target] == 0 ||
+	       ivshm_ring_rx_init(&rx, out, id, in + target * out_size,
+				  out_size, target) < 0)
+		usleep(1000);
+
+	while (1) {
+		msg = ivshm_ring_peek(&rx, &len);
+		if (!msg) {
+			if (++spins < POLL_SPINS)
+				continue;
+			spins = 0;
+
+			if (ivshm_ring_wait_prepare(&rx))
+				continue;
+			wait_for_doorbell(fd, regs);
+			ivshm_ring_wait_finish(&rx);
+			irqs++;
+			continue;
+		}
+		spins = 0;
+
+		if (len >= sizeof(*msg) && msg->type == MSG_PING) {
+			while (!(reply = ivshm_ring_reserve(&tx)))
+				;
+			reply->type = MSG_PONG;
+			reply->seq = msg->seq;
+			ivshm_ring_commit(&tx, sizeof(*reply));
+			if (ivshm_ring_publish(&tx))
+				mmio_write32(&regs->doorbell,
+					     target << 16);
+		} else if (++received % 1000000 == 0) {
+			printf("Received %llu messages, %llu doorbell "
+			       "interrupts\n", received, irqs);
+		}
+		ivshm_ring_release(&rx);
+	}
+}
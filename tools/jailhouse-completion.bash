@@ -117,7 +117,8 @@ function _jailhouse_cell_linux() {
 	cur="${COMP_WORDS[COMP_CWORD]}"
 	prev="${COMP_WORDS[COMP_CWORD-1]}"
 
-	options="-h --help -i --initrd -c --cmdline -w --write-params"
+	options="-h --help -i --initrd -c --cmdline -w --write-params \
+		 -C --cache -r --restart"
 
 	# if we already have begun to write an option
 	if [[ "$cur" == -* ]]; then
@@ -130,6 +131,10 @@ function _jailhouse_cell_linux() {
 			_filedir
 			return $?
 			;;
+		-C|--cache)
+			_filedir -d
+			return $?
+			;;
 		-c|--cmdline)
 			# we can't really predict this
 			return 0
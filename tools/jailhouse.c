@@ -22,9 +22,11 @@
 #include <libgen.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #include <jailhouse.h>
+#include <jailhouse/header.h>
 
 #define JAILHOUSE_EXEC_DIR	LIBEXECDIR "/jailhouse"
 #define JAILHOUSE_DEVICE	"/dev/jailhouse"
@@ -68,6 +70,7 @@ static void __attribute__((noreturn)) help(char *prog, int exit_status)
 	       "   enable SYSCONFIG\n"
 	       "   disable\n"
 	       "   console [-f | --follow]\n"
+	       "   trace [-f | --follow] [-c | --cpu CPU]\n"
 	       "   cell create CELLCONFIG\n"
 	       "   cell list\n"
 	       "   cell load { ID | [--name] NAME } "
@@ -176,6 +179,27 @@ static void *read_file(const char *name, size_t *size)
 	return buffer;
 }
 
+static int open_image_file(const char *name, size_t *size)
+{
+	struct stat stat;
+	int fd;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "opening %s: %s\n", name, strerror(errno));
+		exit(1);
+	}
+
+	if (fstat(fd, &stat) < 0) {
+		perror("fstat");
+		exit(1);
+	}
+
+	*size = stat.st_size;
+
+	return fd;
+}
+
 static char *read_sysfs_cell_string(const unsigned int id, const char *entry)
 {
 	char *ret, buffer[128];
@@ -430,10 +454,14 @@ static int cell_shutdown_load(int argc, char *argv[],
 			image->source_address =
 				(unsigned long)read_string(argv[arg_num++],
 							   &size);
+			image->flags = 0;
+			image->source_fd = -1;
 		} else {
-			image->source_address =
-				(unsigned long)read_file(argv[arg_num++],
-							 &size);
+			/* let the driver read the file directly */
+			image->source_address = 0;
+			image->flags = JAILHOUSE_IMAGE_SOURCE_FD;
+			image->source_fd = open_image_file(argv[arg_num++],
+							   &size);
 		}
 		image->size = size;
 		image->target_address = 0;
@@ -457,7 +485,10 @@ static int cell_shutdown_load(int argc, char *argv[],
 
 	close(fd);
 	for (n = 0, image = cell_load->image; n < images; n++, image++)
-		free((void *)(unsigned long)image->source_address);
+		if (image->flags & JAILHOUSE_IMAGE_SOURCE_FD)
+			close(image->source_fd);
+		else
+			free((void *)(unsigned long)image->source_address);
 	free(cell_load);
 
 	return err;
@@ -553,6 +584,135 @@ out:
 	return ret;
 }
 
+static void trace_print(const struct jailhouse_trace_ring *ring,
+			const struct jailhouse_trace_event *event)
+{
+	printf("%3u %20llu ", ring->cpu_id, event->timestamp);
+
+	switch (event->type) {
+	case JAILHOUSE_TRACE_EXIT:
+		printf("exit   reason %u, %u ticks\n", event->code,
+		       event->duration);
+		break;
+	case JAILHOUSE_TRACE_MMIO:
+		printf("mmio   %s 0x%llx, handler 0x%llx\n",
+		       event->code ? "write" : "read", event->arg[0],
+		       event->arg[1]);
+		break;
+	case JAILHOUSE_TRACE_IRQ:
+		printf("irq    %llu to %u, sender %llu\n", event->arg[0],
+		       event->code, event->arg[1]);
+		break;
+	default:
+		printf("type %u, code %u, 0x%llx 0x%llx\n", event->type,
+		       event->code, event->arg[0], event->arg[1]);
+		break;
+	}
+}
+
+/*
+ * Print the events from tail on and return the new tail. An event is only
+ * valid if the ring head did not advance by the ring size or more while it
+ * was copied, otherwise the hypervisor may have reused the slot.
+ */
+static unsigned int trace_dump(const struct jailhouse_trace_ring *ring,
+			       unsigned int tail)
+{
+	struct jailhouse_trace_event event;
+	unsigned int head;
+
+	while (1) {
+		head = ring->head;
+		__sync_synchronize();
+
+		if (head - tail >= ring->size) {
+			printf("%3u <missed %u events>\n", ring->cpu_id,
+			       head - tail - ring->size + 1);
+			tail = head - ring->size + 1;
+		}
+		if (tail == head)
+			return tail;
+
+		event = ring->events[tail & (ring->size - 1)];
+		__sync_synchronize();
+
+		if (ring->head - tail >= ring->size)
+			continue;
+
+		trace_print(ring, &event);
+		tail++;
+	}
+}
+
+static int trace(int argc, char *argv[])
+{
+	struct jailhouse_trace_ring **rings = NULL;
+	unsigned int *tails = NULL;
+	unsigned int num_cpus = 0, cpu, stride;
+	bool follow = false;
+	int cpu_filter = -1;
+	long page_size;
+	void *ring;
+	int arg, fd;
+
+	for (arg = 2; arg < argc; arg++) {
+		if (match_opt(argv[arg], "-f", "--follow"))
+			follow = true;
+		else if (match_opt(argv[arg], "-c", "--cpu") &&
+			 arg + 1 < argc)
+			cpu_filter = strtoul(argv[++arg], NULL, 0);
+		else
+			help(argv[0], 1);
+	}
+
+	fd = open_dev();
+
+	page_size = sysconf(_SC_PAGESIZE);
+	ring = mmap(NULL, page_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED) {
+		perror("mmap(trace)");
+		close(fd);
+		return 1;
+	}
+	stride = ((struct jailhouse_trace_ring *)ring)->stride;
+	munmap(ring, page_size);
+
+	while (1) {
+		ring = mmap(NULL, stride, PROT_READ, MAP_SHARED, fd,
+			    (off_t)num_cpus * stride);
+		if (ring == MAP_FAILED)
+			break;
+
+		rings = realloc(rings, (num_cpus + 1) * sizeof(*rings));
+		tails = realloc(tails, (num_cpus + 1) * sizeof(*tails));
+		if (!rings || !tails) {
+			fprintf(stderr, "insufficient memory\n");
+			exit(1);
+		}
+		rings[num_cpus] = ring;
+		/* start with the oldest event that is still available */
+		tails[num_cpus] = rings[num_cpus]->head;
+		if (tails[num_cpus] >= rings[num_cpus]->size)
+			tails[num_cpus] -= rings[num_cpus]->size - 1;
+		else
+			tails[num_cpus] = 0;
+		num_cpus++;
+	}
+	close(fd);
+
+	do {
+		for (cpu = 0; cpu < num_cpus; cpu++)
+			if (cpu_filter < 0 || cpu == (unsigned int)cpu_filter)
+				tails[cpu] = trace_dump(rings[cpu],
+							tails[cpu]);
+		fflush(stdout);
+		if (follow)
+			usleep(10000);
+	} while (follow);
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	int fd;
@@ -573,6 +733,8 @@ int main(int argc, char *argv[])
 		err = cell_management(argc, argv);
 	} else if (strcmp(argv[1], "console") == 0) {
 		err = console(argc, argv);
+	} else if (strcmp(argv[1], "trace") == 0) {
+		err = trace(argc, argv);
 	} else if (strcmp(argv[1], "config") == 0 ||
 		   strcmp(argv[1], "hardware") == 0) {
 		call_extension_script(argv[1], argc, argv);